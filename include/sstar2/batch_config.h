@@ -0,0 +1,26 @@
+// analyses of a batch run, sharing one pass over the vcf
+// the batch file has a section per analysis, in the order they are run:
+//   [name]
+//   targets = EUR
+//   references = AFR,YRI
+//   excluded = ...
+//   include-bed = file,...
+//   exclude-bed = file,...
+//   output = file
+// Lists are comma separated.  Blank lines and lines starting with # are
+// ignored.  Targets, references and output are required.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <iostream>
+
+struct Analysis{
+    std::string name;
+    std::vector<std::string> targets, references, excluded;
+    std::vector<std::string> include_beds, exclude_beds;
+    std::string output;
+};
+
+// throws invalid_argument naming the line of any error
+std::vector<Analysis> read_batch_config(std::istream &input);
@@ -0,0 +1,48 @@
+// reads records of a bcf file, BCF2.2, uncompressed or bgzip compressed
+// genotypes follow the rules of VcfFile::parse_line: only biallelic snps
+// are kept, GT must be the first FORMAT field, missing first alleles are 0
+// and genotypes without a phased second allele warn as unphased.
+// Haploid genotypes only set the first haplotype.
+
+#pragma once
+#include <set>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+
+#include "sstar2/record_source.h"
+
+struct BcfChromosome{
+    std::string name;
+    uint64_t offset;  // of the first record
+};
+
+class BcfRecordSource : public RecordSource{
+    std::istream &input;
+    std::vector<std::string> contigs;
+    std::vector<std::string> samples;
+    int gt_key = -1;  // dictionary index of GT
+    std::vector<unsigned int> columns;  // sample of each kept individual
+    std::vector<char> shared, individual;  // data of the current record
+
+    bool read_record();
+    uint64_t tell();
+
+    public:
+        BcfRecordSource(std::istream &input) : input(input) {};
+
+        // throws invalid_argument if input is not a bcf
+        bool read_header(VcfFile &vcf_file,
+                const std::set<std::string> &individuals);
+        bool next_record(VcfFile &vcf_file, VcfEntry &entry);
+        // offset is a bgzf virtual offset for bgzip input, else a position
+        void seek(uint64_t offset);
+
+        // read through the records after the header, recording where each
+        // chromosome starts.  Throws if a chromosome is not contiguous
+        std::vector<BcfChromosome> scan_chromosomes();
+};
+
+// true if the decompressed input starts as a bcf
+bool is_bcf(std::istream &input);
@@ -0,0 +1,41 @@
+// processes the chromosomes of a vcf file at the same time
+// each chromosome is handled independently by a callback writing to its own
+// stream.  A chromosome started once all earlier chromosomes are written
+// writes directly to the output, others write to temporary files which are
+// copied to the output in vcf order as they finish.
+
+#pragma once
+#include <vector>
+#include <string>
+#include <iostream>
+#include <functional>
+#include <stdint.h>
+
+#include "sstar2/vcf_index.h"
+#include "sstar2/gzip_stream.h"
+
+struct ChromosomeStart{
+    std::string chromosome;
+    uint64_t offset;  // of the first record
+};
+
+// chromosomes with records in the index, offsets are bgzf virtual offsets
+std::vector<ChromosomeStart> index_chromosomes(const VcfIndex &index);
+// read through the vcf recording where each chromosome starts.  Offsets are
+// bgzf virtual offsets when input is the buffer of vcf, or else stream
+// positions.  Throws if a chromosome is not contiguous
+std::vector<ChromosomeStart> scan_chromosomes(std::istream &vcf,
+        GzipStreamBuf *input = nullptr);
+
+class ChromosomeRunner{
+    unsigned int threads;
+
+    public:
+        ChromosomeRunner(unsigned int threads) : threads(threads) {};
+
+        // call process for each chromosome, concatenating the outputs.
+        // Rethrows the first exception from process after stopping
+        void run(const std::vector<ChromosomeStart> &chromosomes,
+                std::ostream &output,
+                const std::function<void(const ChromosomeStart&, std::ostream&)> &process);
+};
@@ -0,0 +1,61 @@
+// binary cache of the biallelic snps of a vcf, written by sstar2 convert
+// and read through a memory map in place of the vcf.  Integers are in
+// native (little endian) byte order, with sections aligned to 8 bytes:
+//   "SSTARGC\2", uint32 samples, uint32 words per haplotype
+//   sample names, each null terminated
+//   records: uint64 position, char ref, char alt, 6 bytes padding,
+//       uint64 words of first haplotypes, then of second haplotypes, then
+//       of individuals with unphased genotypes
+//   chromosomes: uint64 first record, uint64 records, null terminated name
+//   uint64 chromosomes, uint64 offset of the chromosomes
+// Genotypes are as parsed by VcfFile, with bit i of a word set when
+// individual 64 * word + i carries the alternative allele.
+
+#pragma once
+#include <set>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+
+#include "sstar2/record_source.h"
+#include "sstar2/line_source.h"
+
+struct CacheChromosome{
+    std::string name;
+    uint64_t first;  // record
+    uint64_t records;
+};
+
+// write the records of input as a genotype cache.  Throws if a chromosome
+// is not contiguous
+void write_genotype_cache(RecordSource &input, std::ostream &output);
+
+// true if filename starts as a genotype cache
+bool is_genotype_cache(const std::string &filename);
+
+// reads a genotype cache, seeking to record numbers
+class GenotypeCache : public RecordSource{
+    MemoryMap map;
+    std::vector<std::string> samples;
+    std::vector<CacheChromosome> chromosome_table;
+    const char *records = nullptr;
+    size_t words = 0, stride = 0;
+    uint64_t total_records = 0;
+
+    std::vector<unsigned int> columns;  // sample of each kept individual
+    uint64_t next = 0;
+    size_t chromosome = 0;
+
+    public:
+        // throws invalid_argument if filename is not a valid cache
+        GenotypeCache(const std::string &filename);
+        const std::vector<CacheChromosome> &chromosomes() const {
+            return chromosome_table;
+        }
+
+        bool read_header(VcfFile &vcf_file,
+                const std::set<std::string> &individuals);
+        bool next_record(VcfFile &vcf_file, VcfEntry &entry);
+        void seek(uint64_t record);
+};
@@ -0,0 +1,18 @@
+// vectorized decoding of runs of genotype fields from a vcf line
+// fields of exactly 3 characters followed by a tab are decoded as in
+// VcfFile::parse_line: a leading . is missing (0), otherwise each allele
+// of 1 sets a bit of the haplotype.  Any separator other than | is unphased
+// unless the field is missing.
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sstar2/simd.h"
+
+// decode up to count fields starting at start into genotypes, stopping at
+// the first field which is not 3 characters followed by a tab before end.
+// Sets unphased if a decoded field is not separated by |.
+// Returns the number of fields decoded
+size_t decode_genotypes(SimdLevel level, const char *start, const char *end,
+        size_t count, uint8_t *genotypes, bool &unphased);
@@ -0,0 +1,69 @@
+// stream buffer for reading gzip compressed vcf files
+// BGZF files are split into their independent blocks, which are inflated
+// in batches on a thread pool while the previous batch is being read.
+// Other gzip files are inflated on the calling thread.
+
+#pragma once
+#include <streambuf>
+#include <istream>
+#include <vector>
+#include <string>
+#include <future>
+#include <stdint.h>
+#include <zlib.h>
+
+#include "sstar2/thread_pool.h"
+
+// true if the next byte of input starts a gzip member
+bool is_gzipped(std::istream &input);
+
+class GzipStreamBuf : public std::streambuf{
+    struct Block{
+        uint64_t address;  // offset of the block in the input
+        std::vector<char> compressed;  // deflate data, crc and size
+        std::vector<char> data;
+    };
+
+    std::istream &input;
+    bool bgzf = false;
+    std::string header;  // bytes read while detecting the format
+
+    // bgzf state
+    ThreadPool pool;
+    size_t batch_size;
+    std::vector<Block> batch, next_batch;
+    size_t batch_blocks = 0, current_block = 0;
+    std::future<size_t> pending;
+    uint64_t next_address = 0;  // of the next block read from input
+    uint64_t start_address = 0;  // of the next block used after a seek
+
+    // single threaded gzip state
+    z_stream stream;
+    bool stream_open = false;
+    bool stream_finished = false;
+    std::vector<char> in_buffer, out_buffer;
+
+    void read_header();
+    bool read_block(Block &block);
+    size_t read_batch(std::vector<Block> &blocks);
+    bool next_bgzf();
+    bool next_gzip();
+
+    protected:
+        int_type underflow();
+
+    public:
+        // input must be positioned at the start of a gzip member
+        GzipStreamBuf(std::istream &input, unsigned int threads = 1);
+        ~GzipStreamBuf();
+        GzipStreamBuf(const GzipStreamBuf&) = delete;
+        GzipStreamBuf& operator=(const GzipStreamBuf&) = delete;
+
+        bool is_bgzf() const { return bgzf; }
+        // move to a bgzf virtual offset, the compressed offset of a block
+        // shifted left 16 bits plus the offset into the inflated block.
+        // Only valid for bgzf files with seekable input
+        void seek(uint64_t virtual_offset);
+        // virtual offset of the next character
+        uint64_t tell() const;
+};
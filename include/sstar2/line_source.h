@@ -0,0 +1,60 @@
+// sources of vcf lines for the WindowGenerator
+// lines are returned as a pointer and length, without the newline, and are
+// valid until the next call to next_line.  Lines are not null terminated.
+
+#pragma once
+#include <string>
+#include <iostream>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sstar2/gzip_stream.h"
+
+class LineSource{
+    public:
+        // false at the end of input
+        virtual bool next_line(const char *&line, size_t &length) = 0;
+        // continue reading from offset, a position in the file or a bgzf
+        // virtual offset for bgzip input
+        virtual void seek(uint64_t offset) = 0;
+        virtual ~LineSource() = default;
+};
+
+// reads lines from a stream with getline
+// streams reading through a GzipStreamBuf are seeked by virtual offset
+class IstreamLineSource : public LineSource{
+    std::istream &input;
+    std::string buffer;
+
+    public:
+        IstreamLineSource(std::istream &input) : input(input) {};
+        bool next_line(const char *&line, size_t &length);
+        void seek(uint64_t offset);
+};
+
+// a whole file mapped read only for sequential reading
+class MemoryMap{
+    public:
+        const char *data = nullptr;
+        size_t size = 0;
+
+        MemoryMap(const std::string &filename);
+        ~MemoryMap();
+        MemoryMap(const MemoryMap&) = delete;
+        MemoryMap& operator=(const MemoryMap&) = delete;
+};
+
+// reads lines directly from a memory mapped, uncompressed file
+class MmapLineSource : public LineSource{
+    MemoryMap map;
+    size_t position = 0;
+
+    public:
+        MmapLineSource(const std::string &filename) : map(filename) {};
+
+        bool next_line(const char *&line, size_t &length);
+        void seek(uint64_t offset);
+};
+
+// true if filename is a regular file which can be memory mapped
+bool can_mmap(const std::string &filename);
@@ -0,0 +1,31 @@
+// text for an output stream, gathered in a reusable buffer and passed to
+// the stream in a single write.  Numbers are formatted as an ostream with
+// default flags would, without going through the stream or its locale
+
+#pragma once
+#include <string>
+#include <iostream>
+
+class OutputBuffer{
+    std::string text;
+    void append_unsigned(unsigned long long value);
+    void append_signed(long long value);
+
+    public:
+        OutputBuffer &operator<<(char value) { text.push_back(value); return *this; }
+        OutputBuffer &operator<<(const char *value) { text.append(value); return *this; }
+        OutputBuffer &operator<<(const std::string &value) { text.append(value); return *this; }
+        OutputBuffer &operator<<(int value) { append_signed(value); return *this; }
+        OutputBuffer &operator<<(long value) { append_signed(value); return *this; }
+        OutputBuffer &operator<<(long long value) { append_signed(value); return *this; }
+        OutputBuffer &operator<<(unsigned int value) { append_unsigned(value); return *this; }
+        OutputBuffer &operator<<(unsigned long value) { append_unsigned(value); return *this; }
+        OutputBuffer &operator<<(unsigned long long value) { append_unsigned(value); return *this; }
+
+        const char *data() const { return text.data(); }
+        size_t size() const { return text.size(); }
+        // keeps the buffer for reuse
+        void clear() { text.clear(); }
+        // write the text to output and clear
+        void flush(std::ostream &output);
+};
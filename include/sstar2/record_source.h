@@ -0,0 +1,38 @@
+// sources of parsed vcf records for the WindowGenerator
+// a VcfFile selects the individuals kept in each VcfEntry
+
+#pragma once
+#include <set>
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+#include "sstar2/vcf_file.h"
+#include "sstar2/line_source.h"
+
+class RecordSource{
+    public:
+        // read the header, setting up the individuals of vcf_file.
+        // False if there is no header
+        virtual bool read_header(VcfFile &vcf_file,
+                const std::set<std::string> &individuals) = 0;
+        // the next biallelic snp, false at the end of input
+        virtual bool next_record(VcfFile &vcf_file, VcfEntry &entry) = 0;
+        // continue reading from offset, as given by an index or chromosome
+        virtual void seek(uint64_t offset) = 0;
+        virtual ~RecordSource() = default;
+};
+
+// parses the text lines of a vcf
+class VcfRecordSource : public RecordSource{
+    std::unique_ptr<LineSource> lines;
+
+    public:
+        VcfRecordSource(std::unique_ptr<LineSource> lines) :
+            lines(std::move(lines)) {};
+
+        bool read_header(VcfFile &vcf_file,
+                const std::set<std::string> &individuals);
+        bool next_record(VcfFile &vcf_file, VcfEntry &entry);
+        void seek(uint64_t offset) { lines->seek(offset); }
+};
@@ -0,0 +1,64 @@
+// one pass over a RecordSource shared by several WindowGenerators
+// records are parsed once for the union of the individuals of all readers
+// and buffered until every reader has passed them.  Each reader selects its
+// own individuals from the shared records, so generators see the same
+// entries as when reading the source directly.  Readers cannot seek.
+
+#pragma once
+#include <set>
+#include <deque>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "sstar2/record_source.h"
+
+class SharedRecords;
+
+class SharedRecordReader : public RecordSource{
+    SharedRecords &records;
+    size_t id;
+    std::vector<unsigned int> columns;  // shared individual of each kept one
+
+    public:
+        SharedRecordReader(SharedRecords &records, size_t id) :
+            records(records), id(id) {};
+
+        bool read_header(VcfFile &vcf_file,
+                const std::set<std::string> &individuals);
+        bool next_record(VcfFile &vcf_file, VcfEntry &entry);
+        // throws logic_error
+        void seek(uint64_t offset);
+        // number of records read so far
+        uint64_t position() const;
+};
+
+class SharedRecords{
+    friend class SharedRecordReader;
+
+    std::unique_ptr<RecordSource> source;
+    VcfFile vcf_file;
+    bool has_header;
+    bool input_done = false;
+    std::deque<VcfEntry> buffer;
+    std::vector<VcfEntry> spare;  // trimmed entries for reuse
+    uint64_t first = 0;  // record number of the front of buffer
+    std::vector<uint64_t> cursors;  // next record of each reader
+
+    // the record numbered record, false past the end of input
+    const VcfEntry *get(uint64_t record);
+    void trim();
+
+    public:
+        // reads the header of source, keeping individuals; all
+        // individuals if empty
+        SharedRecords(std::unique_ptr<RecordSource> source,
+                const std::set<std::string> &individuals);
+
+        // a new reader starting from the first record.  Readers must not
+        // outlive this
+        std::unique_ptr<SharedRecordReader> reader();
+        // records held for readers which are behind
+        size_t buffered() const { return buffer.size(); }
+};
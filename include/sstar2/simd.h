@@ -0,0 +1,11 @@
+// runtime detection of the vector instruction sets used by the kernels
+
+#pragma once
+#include <vector>
+
+enum class SimdLevel { scalar, sse4, avx2 };
+
+// highest instruction set supported by the running cpu
+SimdLevel detect_simd_level();
+// every instruction set supported by the running cpu, scalar first
+std::vector<SimdLevel> supported_simd_levels();
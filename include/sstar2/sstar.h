@@ -4,11 +4,60 @@
 #include <string>
 #include <map>
 #include <algorithm>
+#include <memory>
+#include <sstream>
+#include <atomic>
 #include "sstar2/window_generator.h"
+#include "sstar2/sstar_kernel.h"
+#include "sstar2/thread_pool.h"
+#include "sstar2/output_buffer.h"
 
-class SStarCaller{
+// values shared by every row of a window
+struct WindowSummary{
+    std::string chromosome;
+    unsigned long start = 0, end = 0;
+    unsigned int total_snps = 0, ref_snps = 0, callable = 0;
+};
+
+// copy of a window which can be scored after the generator moves on
+struct WindowSnapshot{
+    WindowSummary summary;
+    const std::vector<std::string> *target_names = nullptr;
+    const std::vector<std::string> *population_names = nullptr;
+    std::vector<unsigned int> individual_snps;
+    // only filled for targets with more than 2 snps
+    std::vector<std::vector<WindowGT>> genotypes;
+    // target with the same genotypes scored in place of each target
+    std::vector<size_t> duplicate_of;
+    // sstar fields of each scored target, for every setting
+    std::vector<std::vector<std::string>> fields;
+};
+
+// working memory for scoring one target, one per thread
+struct TargetScratch{
+    std::vector<WindowGT> selected;  // sstar snps when not scored in place
+    SStarBuffer buffer;
+    OutputBuffer row;
+    OutputBuffer fields;  // sstar fields being formatted
+};
+
+// scoring parameters of the dynamic program
+struct SStarSetting{
     long match_bonus;
     long mismatch_penalty;
+};
+
+class SStarCaller{
+    // rows of each target are written for every setting, in order
+    std::vector<SStarSetting> settings;
+    SimdLevel simd_level = detect_simd_level();
+    // targets scored, and skipped as duplicates of another target
+    mutable std::atomic<uint64_t> scored_targets{0}, reused_targets{0};
+
+    std::vector<TargetScratch> scratch;
+    std::unique_ptr<ThreadPool> pool;
+    WindowSnapshot current;  // window of write_window
+    OutputBuffer rows;  // of write_window
 
     const char* emptyline = (
             "0\t0\t.\t" // sstar, num snps, snps
@@ -16,16 +65,60 @@ class SStarCaller{
             "0\t0\t"  // sstar start and end
             "0\t0\t.\t");  // n snps hap 1 and 2, sstar haps
 
+    bool fits_kernel(const std::vector<WindowGT> &genotypes,
+            SStarBuffer &buffer) const;
+    // update the score of snp k from the snps before it
+    void score_kernel(const SStarSetting &setting, SStarBuffer &buffer,
+            size_t k) const;
+    void score_scalar(const SStarSetting &setting,
+            const std::vector<WindowGT> &genotypes, SStarBuffer &buffer,
+            size_t k) const;
+    // run the dynamic program for setting on genotypes, already laid out
+    // in buffer when kernel is set, writing the sstar snps to selected
+    long score(const SStarSetting &setting, bool kernel,
+            const std::vector<WindowGT> &genotypes, SStarBuffer &buffer,
+            std::vector<WindowGT> &selected) const;
+    WindowSummary summarize(WindowGenerator &generator) const;
+    // match each target of snapshot to the first with identical genotypes
+    void find_duplicates(WindowSnapshot &snapshot) const;
+    // score a target of snapshot for every setting, formatting its fields
+    void score_target(WindowSnapshot &snapshot, size_t target,
+            TargetScratch &target_scratch) const;
+    void write_rows(OutputBuffer &output, const WindowSnapshot &snapshot) const;
+    void write_fields(OutputBuffer &output, long s_score,
+            const std::vector<WindowGT> &selected) const;
+
     public:
         SStarCaller() :
-            match_bonus(5000), mismatch_penalty(-10000) {};
+            settings{{5000, -10000}}, scratch(1) {};
         SStarCaller(long bonus, long penalty) :
-            match_bonus(bonus), mismatch_penalty(penalty) {};
+            settings{{bonus, penalty}}, scratch(1) {};
+        // every pair of bonuses and penalties, by bonus then penalty.  With
+        // more than one setting, rows end with the bonus and penalty
+        SStarCaller(const std::vector<long> &bonuses,
+                const std::vector<long> &penalties);
 
+        // score the targets of each window on this many threads
+        void set_threads(unsigned int threads);
         void write_header(std::ostream &output);
         // write the current window in generator
         void write_window(std::ostream &output,
                 WindowGenerator &generator);
-        // calculates sstar and updates the windowGT to include just snps
+        // copy the current window of generator, false if nothing to write
+        bool take_snapshot(WindowGenerator &generator,
+                WindowSnapshot &snapshot) const;
+        // format a window from take_snapshot, safe to call from many threads
+        // with separate scratch
+        void write_snapshot(OutputBuffer &output, WindowSnapshot &snapshot,
+                TargetScratch &target_scratch) const;
+        // calculates sstar with the first setting and updates the windowGT
+        // to include just snps
         long sstar(std::vector<WindowGT> &genotypes);
+        long sstar(std::vector<WindowGT> &genotypes, SStarBuffer &buffer) const;
+        // override the runtime detected instruction set
+        void set_simd_level(SimdLevel level) { simd_level = level; }
+        // targets of the windows written so far which were scored, and
+        // which reused the scores of a target with identical genotypes
+        uint64_t targets_scored() const { return scored_targets; }
+        uint64_t targets_reused() const { return reused_targets; }
 };
@@ -0,0 +1,35 @@
+// vectorized kernels for the inner loop of the sstar dynamic program
+// the instruction set is chosen at runtime, falling back to a portable
+// scalar loop when SSE4.1 and AVX2 are unavailable
+
+#pragma once
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sstar2/simd.h"
+
+// structure of arrays holding the snps of one individual in a window
+// along with the dynamic program state
+struct SStarBuffer {
+    std::vector<int32_t> positions;  // relative to the first snp
+    std::vector<int32_t> genotypes;
+    std::vector<int32_t> scores;
+    std::vector<long> previous;  // index of the extended snp
+    std::vector<uint8_t> chain_start;  // true if score is from a new pair
+
+    void resize(size_t nsnps);
+};
+
+struct Predecessor {
+    long index;  // -1 when no snp is at least 10 bp before
+    int32_t score;
+    bool chain_start;
+};
+
+// find the best predecessor j < k for snp k
+// each j contributes max(scores[j] + new_score, new_score).  Ties keep the
+// smallest j and prefer extending over starting a chain, matching the
+// sequential scan in SStarCaller::sstar
+Predecessor best_predecessor(SimdLevel level, const SStarBuffer &buffer,
+        size_t k, int32_t match_bonus, int32_t mismatch_penalty);
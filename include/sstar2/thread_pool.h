@@ -0,0 +1,38 @@
+// fixed size pool of worker threads for running independent tasks
+// the calling thread takes part as worker 0, so a pool of size 1 runs
+// everything serially without starting any threads
+
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+class ThreadPool{
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_work, finished_work;
+    const std::function<void(size_t, unsigned int)> *task = nullptr;
+    size_t task_count = 0;
+    std::atomic<size_t> next_task{0};
+    unsigned long generation = 0;
+    unsigned int running = 0;
+    bool stopping = false;
+
+    void work(unsigned int worker);
+    void run_tasks(unsigned int worker);
+
+    public:
+        ThreadPool(unsigned int threads);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        unsigned int size() const { return workers.size() + 1; }
+        // call task(index, worker) for each index in [0, count), blocking
+        // until all are complete.  worker is in [0, size())
+        void parallel_for(size_t count,
+                const std::function<void(size_t, unsigned int)> &task);
+};
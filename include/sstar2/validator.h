@@ -3,19 +3,40 @@
 #include <iostream>
 #include <sstream>
 #include <vector>
-#include <list>
-#include <map>
+#include <memory>
 
 #include "sstar2/vcf_file.h"
 
+// chromosome names interned as small integers, shared by all regions.
+// Safe to call from multiple threads
+namespace chromosome_ids{
+    unsigned int id(const std::string &chromosome);
+    const std::string &name(unsigned int id);
+}
+
+// a (start, end] interval
+struct Interval{
+    unsigned long start, end;
+};
+
 class BaseRegions{
-    // contains a chromosome pointing to a list of start/end positions
+    // sorted intervals of each chromosome, indexed by chromosome id
     // works to store a bed file or callable bases
-    std::map<std::string, std::list<unsigned long>> positions;
+    std::vector<std::vector<Interval>> intervals;
+    std::vector<unsigned int> chromosomes;  // ids with an entry in intervals
+    std::vector<bool> present;  // of each id
+    std::vector<Interval> buffer;  // result of intersect and subtract
+    // last chromosome looked up, to skip interning
+    std::string last_name;
+    unsigned int last_id = 0;
+    unsigned int chromosome_id(const std::string &chrom);
+    // intervals of chrom, or null if it has no entry
+    const std::vector<Interval> *find(unsigned int id) const;
 
     public:
         // add region, clearing if needed.  Handles overlaps, assumes sorted input
         void add(const std::string &chrom, unsigned long start, unsigned long end);
+        void clear();
         // set region to chromosome with a single entry
         void set(const std::string &chrom, unsigned long start, unsigned long end);
         // get total callable bases
@@ -26,6 +47,12 @@ class BaseRegions{
         // get the first chromosome
         const std::string getChromosome() const;
         unsigned long getEnd(const std::string &chromosome);
+        // intervals of chromosome, empty if it has none
+        const std::vector<Interval> &getIntervals(const std::string &chromosome);
+        // start of the first interval of chromosome, false if there is none
+        bool getStart(const std::string &chromosome, unsigned long &start);
+        // remove intervals of chromosome ending at or before position
+        void discardBefore(const std::string &chromosome, unsigned long position);
         bool inRegion(const std::string &chromosome, unsigned long position);
 };
 std::ostream& operator<<(std::ostream &strm, const BaseRegions region);
@@ -40,17 +67,27 @@ class Validator{
 class FixationValidator : public Validator{
     std::vector<unsigned int> targets;
     std::vector<unsigned int> references;
+    // for packed entries
+    HaplotypeMask target_mask;
+    HaplotypeMask reference_mask;
 
     public:
+        FixationValidator() = default;
         FixationValidator(
                 std::vector<unsigned int> target_inds,
                 std::vector<unsigned int> reference_inds) :
-            targets(target_inds), references(reference_inds) {};
+            targets(target_inds), references(reference_inds),
+            target_mask(target_inds), reference_mask(reference_inds) {};
 
         bool isValid(const VcfEntry &entry);
+        // isValid, also giving the reference haplotypes counted on the way
+        bool isSegregating(const VcfEntry &entry,
+                unsigned int &reference_haplotypes) const;
         void updateCallable(BaseRegions &callable){}
 };
 
+// reads a bed file along with the vcf, keeping intervals which can still
+// overlap the current or later windows
 class BedFile{
     std::istream *bedfile;
     std::string chromosome;
@@ -61,6 +98,8 @@ class BedFile{
     public:
         BedFile(std::istream *file) : bedfile(file), chromosome("*") {};
         bool inBed(std::string chrom, unsigned long position);
+        // read through the end of callable and drop intervals before it
+        void advance(BaseRegions &callable);
         void intersect(BaseRegions &callable);
         void subtract(BaseRegions &callable);
 };
@@ -86,3 +125,57 @@ class NegativeBedValidator : public Validator{
         bool isValid(const VcfEntry &entry);
         void updateCallable(BaseRegions &callable);
 };
+
+// callable bases of a chromosome as intervals with running totals.  Each
+// stretch of the chromosome is passed through the validators once, as
+// windows reach it, and the callable bases of a window are then found with
+// two binary searches instead of applying every validator to every window
+class CallableIndex{
+    std::string chromosome;
+    unsigned long begin = 0, computed = 0;  // intervals cover (begin, computed]
+    std::vector<Interval> intervals;
+    // callable bases before each interval, relative to the first
+    std::vector<unsigned long> covered{0};
+    size_t cursor = 0;  // interval of the last contains
+    BaseRegions chunk, mask;
+    void reset(const std::string &chrom, unsigned long start);
+    // pass (computed, end] through the validators
+    void extend(unsigned long end,
+            std::vector<std::unique_ptr<Validator>> &validators);
+    // drop intervals ending at or before start once they are most of the index
+    void evict(unsigned long start);
+    // callable bases at or before position
+    unsigned long count(unsigned long position) const;
+
+    public:
+        // callable bases of (start, end] of chrom.  Windows must only move
+        // forward through a chromosome, as the validators read their beds,
+        // and a start before an earlier start throws std::logic_error
+        unsigned long length(const std::string &chrom,
+                unsigned long start, unsigned long end,
+                std::vector<std::unique_ptr<Validator>> &validators);
+        // true if position of chrom is callable.  Unlike length, skipped
+        // parts of a chromosome are still passed through the validators,
+        // and positions must only move forward
+        bool contains(const std::string &chrom, unsigned long position,
+                std::vector<std::unique_ptr<Validator>> &validators);
+        // remove bases of callable which are not callable here, callable
+        // must not start before an earlier call or position of contains
+        void restrict(BaseRegions &callable,
+                std::vector<std::unique_ptr<Validator>> &validators);
+};
+
+// validators applied as one, through an index of the callable bases they
+// leave.  Used to stack bed files, so each record is a single lookup
+// however many are given
+class MaskValidator final : public Validator{
+    std::vector<std::unique_ptr<Validator>> validators;
+    CallableIndex index;
+
+    public:
+        MaskValidator(std::vector<std::unique_ptr<Validator>> validators) :
+            validators(std::move(validators)) {};
+
+        bool isValid(const VcfEntry &entry);
+        void updateCallable(BaseRegions &callable);
+};
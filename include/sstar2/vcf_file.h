@@ -8,27 +8,66 @@
 #include <string>
 #include <map>
 #include <set>
+#include <atomic>
 #include <iostream>
 #include <string.h>
 
+#include "sstar2/simd.h"
+
+// bitmask of a group of individuals, by their index in VcfEntry::genotypes
+class HaplotypeMask{
+    public:
+        std::vector<uint64_t> words;
+
+        HaplotypeMask() = default;
+        HaplotypeMask(const std::vector<unsigned int> &individuals);
+};
+
 struct VcfEntry{
     std::string chromosome;
     unsigned long int position;
     char reference;
     char alternative;
     std::vector<uint8_t> genotypes;
+    // optional bitplanes of the first and second haplotypes of genotypes,
+    // 64 individuals per word.  Empty unless packed
+    std::vector<uint64_t> first_haplotype, second_haplotype;
+    // optional bitplane of individuals with unphased genotypes, in the same
+    // layout.  Empty unless tracked by VcfFile
+    std::vector<uint64_t> unphased_individuals;
 
     VcfEntry(std::string chrom, size_t individuals) :
         chromosome(chrom), genotypes(individuals) {}
     std::string to_str() const;
     bool any_haplotype(const std::vector<unsigned int> &individuals) const;
     unsigned int count_haplotypes(const std::vector<unsigned int> &individuals) const;
+
+    // update the bitplanes from genotypes
+    void pack_haplotypes();
+    bool is_packed() const { return !first_haplotype.empty(); }
+    // set the unphased bit of individual, if tracked
+    void mark_unphased(size_t individual){
+        if(!unphased_individuals.empty())
+            unphased_individuals[individual / 64] |= (uint64_t)1 << (individual % 64);
+    }
+    // as above for packed entries
+    bool any_haplotype(const HaplotypeMask &individuals) const;
+    unsigned int count_haplotypes(const HaplotypeMask &individuals) const;
 };
 
 class VcfFile{
     // if user has been warned about unphased data
     bool warned_unphased = false;
+    // set by the first of several files to warn, if shared
+    std::atomic<bool> *shared_warned = nullptr;
+    uint64_t unphased = 0;  // genotypes found, warned or not
     std::vector<unsigned int> individual_indices;
+    // number of adjacent selected columns starting at each individual
+    std::vector<unsigned int> individual_runs;
+    SimdLevel simd_level = detect_simd_level();
+    bool pack_haplotypes = false;
+    bool track_unphased = false;
+    bool parse_fields(const char* line, size_t length, VcfEntry &entry);
 
     public:
         // map of individual to position in vcf file
@@ -36,6 +75,23 @@ class VcfFile{
 
         unsigned int initialize_individuals(const std::string &line,
                 const std::set<std::string> &individuals);
+        // as above with the sample names of the header line
+        unsigned int initialize_individuals(const std::vector<std::string> &samples,
+                const std::set<std::string> &individuals);
         VcfEntry initialize_entry();
         bool parse_line(const char* line, VcfEntry &entry);
+        // line of length characters, need not be null terminated
+        bool parse_line(const char* line, size_t length, VcfEntry &entry);
+        void set_simd_level(SimdLevel level) { simd_level = level; }
+        // keep bitplanes of parsed entries, set before initialize_entry
+        void set_pack_haplotypes(bool pack) { pack_haplotypes = pack; }
+        bool packs_haplotypes() const { return pack_haplotypes; }
+        // keep the unphased individuals of parsed entries, set before
+        // initialize_entry
+        void set_track_unphased(bool track) { track_unphased = track; }
+        // warn once about unphased genotypes, for readers of other formats
+        void warn_unphased(const VcfEntry &entry);
+        // warn once across all files sharing warned, which must outlive them
+        void share_unphased_warning(std::atomic<bool> &warned) { shared_warned = &warned; }
+        uint64_t unphased_genotypes() const { return unphased; }
 };
@@ -0,0 +1,51 @@
+// reads tabix (.tbi) and coordinate sorted (.csi) indices of bgzip
+// compressed vcf files to find the blocks holding a region.
+// Offsets are bgzf virtual offsets, usable with GzipStreamBuf::seek
+
+#pragma once
+#include <vector>
+#include <string>
+#include <map>
+#include <iostream>
+#include <stdint.h>
+
+struct IndexChunk{
+    uint64_t begin, end;  // virtual offsets of [begin, end)
+    bool operator==(const IndexChunk& rhs) const;
+};
+
+class VcfIndex{
+    struct Bin{
+        uint64_t loffset = 0;  // only set for csi indices
+        std::vector<IndexChunk> chunks;
+    };
+    struct Reference{
+        std::map<uint32_t, Bin> bins;
+        std::vector<uint64_t> linear;  // only set for tabix indices
+    };
+
+    int min_shift = 14, depth = 5;
+    bool csi = false;
+    std::vector<std::string> names;
+    std::vector<Reference> references;
+
+    void read_names(std::istream &index, uint32_t length);
+    void read_tabix(std::istream &index);
+    void read_csi(std::istream &index);
+    void read_references(std::istream &index);
+    uint64_t min_offset(const Reference &reference, unsigned long start) const;
+
+    public:
+        // index may be bgzip compressed, as written by tabix and bcftools
+        VcfIndex(std::istream &index);
+
+        // chromosomes in the order they appear in the vcf
+        const std::vector<std::string> &chromosomes() const { return names; }
+        // sorted, merged chunks which may hold records of chromosome with
+        // positions in (start, end].  Empty if the chromosome has no records
+        std::vector<IndexChunk> query(const std::string &chromosome,
+                unsigned long start, unsigned long end) const;
+};
+
+// index file next to vcf_file, trying .tbi then .csi.  Empty if neither exist
+std::string find_index(const std::string &vcf_file);
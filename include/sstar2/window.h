@@ -5,6 +5,7 @@
 #include <memory>
 #include <iostream>
 #include <sstream>
+#include <stdint.h>
 #include "sstar2/validator.h"
 
 struct WindowGT {
@@ -39,31 +40,66 @@ class Window {
                 const std::vector<unsigned int> &targets,
                 unsigned int reference_haplotypes) = 0;
 
+        // called once the window is complete, before its genotypes are read
+        virtual void finish_window() {}
         virtual void fill_genotypes(std::vector<WindowGT> &genotypes, int individual) const = 0;
         virtual unsigned int total_snps() const = 0;
         virtual unsigned int reference_snps() const = 0;
         virtual unsigned int individual_snps(unsigned int individual) const = 0;
+        // individual_snps of every target
+        virtual const std::vector<unsigned int> &individual_counts() const = 0;
         virtual void initialize(unsigned int num_targets) = 0;
+        // set the positions (start, end] of chrom which can be recorded,
+        // false if no part of chrom is recorded
+        virtual bool region(const std::string &chrom,
+                unsigned long &start, unsigned long &end) const = 0;
         virtual ~Window() = default;
 };
 
+// genotypes of the targets are kept in one arena per bucket, as columns of
+// positions and genotypes.  They are appended in vcf order and grouped by
+// target once the bucket is complete, giving each target a contiguous range.
+// Storage is reused when the bucket is reset.
 struct WindowBucket {
     unsigned long start=0, end=0;
     unsigned int site_count=0,  // number of snps after removing excluded, fixed, and homozygous ref
         reference_count=0;  // number in any ref
-    std::vector<std::vector<WindowGT>> genotypes;
+    std::vector<unsigned int> counts;  // genotypes of each target
+    std::vector<unsigned long> positions;
+    std::vector<uint8_t> genotypes;
+    // target of each genotype until sealed, then the first genotype of
+    // each target in offsets, followed by the total
+    std::vector<unsigned int> targets;
+    std::vector<unsigned int> offsets;
+    bool sealed = true;
+
+    void initialize(unsigned int num_targets);
     void reset_bucket(unsigned int start, unsigned int end);
+    void add(unsigned int target, unsigned long position, uint8_t genotype);
+    // group the genotypes by target
+    void seal();
+    size_t begin(unsigned int target) const { return offsets[target]; }
+    size_t end_of(unsigned int target) const { return offsets[target + 1]; }
+
+    private:
+        std::vector<unsigned long> sorted_positions;
+        std::vector<uint8_t> sorted_genotypes;
+        std::vector<unsigned int> next;
 };
 
 // A simple, concrete window that yields a given length and step over all
 // positions.
 class StepWindow : public Window {
-    virtual void reset(std::string &chrom);
-    virtual void next();
-
     protected:
         std::deque<WindowBucket> buckets;
         unsigned int step, length;
+        // running totals over the buckets, updated as buckets are recorded
+        // and reset
+        unsigned int site_total = 0, reference_total = 0;
+        std::vector<unsigned int> target_totals;
+        void reset_bucket(WindowBucket &bucket, unsigned int start, unsigned int end);
+        virtual void reset(std::string &chrom);
+        virtual void next();
 
     public:
         StepWindow(unsigned int window_step, unsigned int window_length);
@@ -73,19 +109,28 @@ class StepWindow : public Window {
         bool should_record(VcfEntry &entry) const;
         void record(const VcfEntry &entry, const std::vector<unsigned int> &targets,
                 unsigned int reference_haplotypes);
+        void finish_window();
         void fill_genotypes(std::vector<WindowGT> &genotypes, int individual) const;
         unsigned int total_snps() const;
         unsigned int reference_snps() const;
         unsigned int individual_snps(unsigned int individual) const;
+        const std::vector<unsigned int> &individual_counts() const;
+        bool region(const std::string &chrom,
+                unsigned long &start, unsigned long &end) const;
 };
 
 // a stepping window that has a set of start/end positions
 // similar to step windows but the next and reset code has additional checks
+// windows step from the region start until they start past the region end.
+// Chromosomes without a region, or past the region end, have an empty
+// chromosome and nothing is recorded until the next chromosome.
 class RangedWindow : public StepWindow {
     std::map<std::string, std::pair<unsigned long, unsigned long>> regions;
     unsigned long window_start = 0, window_end = 0;
+    std::string skipped;  // chromosome being read without recording
     void reset(std::string &chrom);
     void next();
+    void skip();
 
     public:
         RangedWindow(unsigned int window_step, unsigned int window_length,
@@ -94,6 +139,8 @@ class RangedWindow : public StepWindow {
                 const std::string &region);
         bool should_break(VcfEntry &entry) const;
         bool should_record(VcfEntry &entry) const;
+        bool region(const std::string &chrom,
+                unsigned long &start, unsigned long &end) const;
 };
 
 std::ostream& operator<<(std::ostream &strm, const Window &window);
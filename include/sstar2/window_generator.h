@@ -9,20 +9,48 @@
 #include "sstar2/population_data.h"
 #include "sstar2/validator.h"
 #include "sstar2/window.h"
+#include "sstar2/vcf_index.h"
+#include "sstar2/line_source.h"
+#include "sstar2/record_source.h"
 
 class WindowGenerator{
+    // part of a chromosome read after seeking to offset
+    struct SeekRegion{
+        std::string chromosome;
+        unsigned long start, end;
+        uint64_t offset;
+    };
 
     bool terminated = false;
 
-    std::istream *vcf = nullptr;
-    std::string vcf_string;
+    std::unique_ptr<RecordSource> vcf;
+    bool input_done = false;
     std::vector<unsigned int> references;
     std::vector<unsigned int> excluded;
+    HaplotypeMask excluded_mask;
+    // all validators, for callable bases
     std::vector<std::unique_ptr<Validator>> validators;
+    // checked for each record without virtual dispatch, fixation first as
+    // it counts the reference haplotypes for record
+    FixationValidator fixation;
+    MaskValidator *mask = nullptr;
+    std::vector<Validator*> record_validators;
+    CallableIndex callable_index;
+
+    const VcfIndex *index = nullptr;
+    bool seeking = false;
+    std::string only_chromosome;
+    uint64_t chromosome_offset = 0;
+    std::vector<SeekRegion> regions;
+    size_t next_region_index = 0;
+    bool seek_pending = false;
 
     void initialize_vcf();
+    void find_regions();
+    bool next_region();
     bool next_line();
-    bool entry_is_valid();
+    // counts reference haplotypes of valid entries
+    bool entry_is_valid(unsigned int &reference_haplotypes);
 
     public:
         VcfFile vcf_file;
@@ -41,6 +69,25 @@ class WindowGenerator{
                 std::set<std::string> &target,
                 std::set<std::string> &reference,
                 std::set<std::string> &exclude);
+        void initialize(
+                std::unique_ptr<LineSource> vcf_input,
+                std::istream &pop_file,
+                std::set<std::string> &target,
+                std::set<std::string> &reference,
+                std::set<std::string> &exclude);
+        void initialize(
+                std::unique_ptr<RecordSource> vcf_input,
+                std::istream &pop_file,
+                std::set<std::string> &target,
+                std::set<std::string> &reference,
+                std::set<std::string> &exclude);
+        // only read the regions of the window, seeking with the index to
+        // bgzf virtual offsets; call before initialize
+        void set_index(const VcfIndex &vcf_index);
+        // only read chromosome.  Without an index, reading starts at offset,
+        // a bgzf virtual offset for bgzip input, a record of a genotype
+        // cache or else a position in the vcf; call before initialize
+        void set_chromosome(const std::string &chromosome, uint64_t offset);
         void add_validator(std::unique_ptr<Validator> validator);
         unsigned int callable_length();
         bool next_window();
@@ -0,0 +1,43 @@
+// runs reading, scoring and writing of windows concurrently
+// one thread reads the vcf with a WindowGenerator and copies each window
+// into a snapshot, a pool of workers score the snapshots and the calling
+// thread writes them in window order.  At most windows_in_flight windows
+// are held in memory at once.
+
+#pragma once
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "sstar2/sstar.h"
+#include "sstar2/window_generator.h"
+
+class WindowPipeline{
+    enum class SlotState { empty, filled, scoring, scored };
+    struct Slot{
+        SlotState state = SlotState::empty;
+        WindowSnapshot snapshot;
+        std::string text;
+    };
+
+    const SStarCaller &caller;
+    unsigned int workers;
+    std::vector<Slot> slots;
+
+    std::mutex mutex;
+    std::condition_variable slot_free, slot_filled, slot_scored;
+    // sequence numbers of windows, next_score <= next_read
+    unsigned long next_read = 0, next_score = 0, next_write = 0;
+    bool reading_done = false;
+    std::exception_ptr read_error;
+
+    void read(WindowGenerator &generator);
+    void score();
+
+    public:
+        WindowPipeline(const SStarCaller &caller, unsigned int workers,
+                unsigned int windows_in_flight);
+
+        void run(WindowGenerator &generator, std::ostream &output);
+};
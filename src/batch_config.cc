@@ -0,0 +1,94 @@
+#include "sstar2/batch_config.h"
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+static std::string trim(const std::string &str){
+    const char *space = " \t\r";
+    size_t start = str.find_first_not_of(space);
+    if(start == std::string::npos)
+        return "";
+    return str.substr(start, str.find_last_not_of(space) - start + 1);
+}
+
+static std::vector<std::string> split_list(const std::string &value){
+    std::vector<std::string> result;
+    std::istringstream stream(value);
+    std::string token;
+    while(std::getline(stream, token, ',')){
+        token = trim(token);
+        if(!token.empty())
+            result.push_back(token);
+    }
+    return result;
+}
+
+static void check_analysis(const Analysis &analysis){
+    std::string missing;
+    if(analysis.targets.empty())
+        missing = "targets";
+    else if(analysis.references.empty())
+        missing = "references";
+    else if(analysis.output.empty())
+        missing = "output";
+    if(!missing.empty())
+        throw std::invalid_argument("Analysis " + analysis.name +
+                " has no " + missing);
+}
+
+std::vector<Analysis> read_batch_config(std::istream &input){
+    std::vector<Analysis> result;
+    std::set<std::string> names;
+    std::string line;
+    unsigned int line_number = 0;
+    while(std::getline(input, line)){
+        ++line_number;
+        line = trim(line);
+        if(line.empty() || line[0] == '#')
+            continue;
+        std::string where = "Batch file line " +
+            std::to_string(line_number) + ": ";
+
+        if(line[0] == '['){
+            if(line.back() != ']')
+                throw std::invalid_argument(where + "unterminated section");
+            if(!result.empty())
+                check_analysis(result.back());
+            result.emplace_back();
+            result.back().name = trim(line.substr(1, line.size() - 2));
+            if(result.back().name.empty())
+                throw std::invalid_argument(where + "empty analysis name");
+            if(!names.insert(result.back().name).second)
+                throw std::invalid_argument(where + "duplicate analysis " +
+                        result.back().name);
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if(equals == std::string::npos)
+            throw std::invalid_argument(where + "expected key = value");
+        if(result.empty())
+            throw std::invalid_argument(where + "setting outside of an analysis");
+        std::string key = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+        Analysis &analysis = result.back();
+        if(key == "targets")
+            analysis.targets = split_list(value);
+        else if(key == "references")
+            analysis.references = split_list(value);
+        else if(key == "excluded")
+            analysis.excluded = split_list(value);
+        else if(key == "include-bed")
+            analysis.include_beds = split_list(value);
+        else if(key == "exclude-bed")
+            analysis.exclude_beds = split_list(value);
+        else if(key == "output")
+            analysis.output = value;
+        else
+            throw std::invalid_argument(where + "unknown key " + key);
+    }
+    if(result.empty())
+        throw std::invalid_argument("Batch file has no analyses");
+    check_analysis(result.back());
+    return result;
+}
@@ -0,0 +1,316 @@
+#include "sstar2/bcf_reader.h"
+#include "sstar2/gzip_stream.h"
+#include <sstream>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <string.h>
+
+static const char MAGIC[5] = {'B', 'C', 'F', '\2', '\2'};
+
+// typed value types of the bcf specification
+enum BcfType { MISSING = 0, INT8 = 1, INT16 = 2, INT32 = 3, FLOAT = 5, CHAR = 7 };
+
+static size_t type_size(int type){
+    switch(type){
+        case MISSING: return 0;
+        case INT8: case CHAR: return 1;
+        case INT16: return 2;
+        case INT32: case FLOAT: return 4;
+    }
+    throw std::invalid_argument("Invalid type in bcf record");
+}
+
+// walks the typed values of a record, throwing on truncation
+class TypedReader{
+    const char *data, *end;
+
+    public:
+        TypedReader(const std::vector<char> &buffer) :
+            data(buffer.data()), end(buffer.data() + buffer.size()) {};
+
+        const char *take(size_t length){
+            if((size_t)(end - data) < length)
+                throw std::invalid_argument("Truncated bcf record");
+            const char *result = data;
+            data += length;
+            return result;
+        }
+        template <typename T>
+        T read(){
+            T value;
+            memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+        int32_t read_int(int type){
+            switch(type){
+                case INT8: return read<int8_t>();
+                case INT16: return read<int16_t>();
+                case INT32: return read<int32_t>();
+            }
+            throw std::invalid_argument("Expected an integer in bcf record");
+        }
+        // descriptor of a typed value, setting type and count
+        void descriptor(int &type, size_t &count){
+            uint8_t byte = read<uint8_t>();
+            type = byte & 0xf;
+            count = byte >> 4;
+            if(count == 15){
+                uint8_t count_type = read<uint8_t>();
+                int32_t value = read_int(count_type & 0xf);
+                if(value < 0)
+                    throw std::invalid_argument("Invalid count in bcf record");
+                count = value;
+            }
+        }
+        int32_t typed_int(){
+            int type;
+            size_t count;
+            descriptor(type, count);
+            if(count != 1)
+                throw std::invalid_argument("Expected an integer in bcf record");
+            return read_int(type);
+        }
+        // typed string, or the values of another type
+        const char *typed_value(size_t &length){
+            int type;
+            size_t count;
+            descriptor(type, count);
+            length = count * type_size(type);
+            return take(length);
+        }
+};
+
+// value of ID=, or IDX= in a header line like ##INFO=<ID=DP,...>
+static std::string header_field(const std::string &line, const std::string &key){
+    size_t start = line.find("<" + key + "=");
+    if(start == std::string::npos)
+        start = line.find("," + key + "=");
+    if(start == std::string::npos)
+        return "";
+    start += key.size() + 2;
+    size_t end = line.find_first_of(",>", start);
+    return line.substr(start, end == std::string::npos ? end : end - start);
+}
+
+// add id to a dictionary at IDX if given, or else the next free index
+static void add_to_dictionary(std::vector<std::string> &dictionary,
+        const std::string &id, const std::string &idx){
+    if(idx.empty()){
+        for(const auto &entry : dictionary)
+            if(entry == id)
+                return;
+        dictionary.push_back(id);
+        return;
+    }
+    size_t index = std::stoul(idx);
+    if(index >= dictionary.size())
+        dictionary.resize(index + 1);
+    dictionary[index] = id;
+}
+
+bool is_bcf(std::istream &input){
+    return input.peek() == MAGIC[0];
+}
+
+bool BcfRecordSource::read_header(VcfFile &vcf_file,
+        const std::set<std::string> &individuals){
+    char magic[sizeof(MAGIC)];
+    uint32_t length;
+    if(!input.read(magic, sizeof(magic)) ||
+            memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::invalid_argument("Input is not a BCF2.2 file");
+    if(!input.read((char*)&length, sizeof(length)))
+        throw std::invalid_argument("Truncated bcf header");
+    std::string text(length, '\0');
+    if(!input.read(&text[0], length))
+        throw std::invalid_argument("Truncated bcf header");
+
+    // PASS is always the first filter
+    std::vector<std::string> dictionary{"PASS"};
+    std::istringstream lines(text.c_str());
+    std::string line;
+    while(std::getline(lines, line)){
+        if(line.compare(0, 9, "##contig=") == 0)
+            add_to_dictionary(contigs, header_field(line, "ID"),
+                    header_field(line, "IDX"));
+        else if(line.compare(0, 9, "##FILTER=") == 0 ||
+                line.compare(0, 7, "##INFO=") == 0 ||
+                line.compare(0, 9, "##FORMAT=") == 0)
+            add_to_dictionary(dictionary, header_field(line, "ID"),
+                    header_field(line, "IDX"));
+        else if(line.compare(0, 6, "#CHROM") == 0){
+            vcf_file.initialize_individuals(line, individuals);
+            std::istringstream columns(line);
+            std::string column;
+            for(int i = 0; std::getline(columns, column, '\t'); ++i)
+                if(i > 8)
+                    samples.push_back(column);
+        }
+    }
+    for(size_t i = 0; i < dictionary.size(); ++i)
+        if(dictionary[i] == "GT")
+            gt_key = i;
+
+    columns.clear();
+    for(const auto &individual : vcf_file.individual_map)
+        columns.push_back(individual.first - 9);
+    return true;
+}
+
+bool BcfRecordSource::read_record(){
+    uint32_t lengths[2];
+    if(!input.read((char*)lengths, sizeof(lengths))){
+        if(input.gcount() != 0)
+            throw std::invalid_argument("Truncated bcf record");
+        return false;
+    }
+    shared.resize(lengths[0]);
+    individual.resize(lengths[1]);
+    if(!input.read(shared.data(), shared.size()) ||
+            !input.read(individual.data(), individual.size()))
+        throw std::invalid_argument("Truncated bcf record");
+    if(shared.size() < 24)
+        throw std::invalid_argument("Truncated bcf record");
+    return true;
+}
+
+// genotypes of the kept individuals from GT values of type T
+template <typename T>
+static void decode_gt(const char *values, size_t ploidy,
+        const std::vector<unsigned int> &columns, VcfEntry &entry,
+        bool &unphased){
+    const T vector_end = std::numeric_limits<T>::min() + 1;
+    for(size_t i = 0; i < columns.size(); ++i){
+        T first, second = vector_end;
+        memcpy(&first, values + columns[i] * ploidy * sizeof(T), sizeof(T));
+        if(ploidy > 1)
+            memcpy(&second, values + (columns[i] * ploidy + 1) * sizeof(T),
+                    sizeof(T));
+        // alleles are stored as (allele + 1) << 1 | phased, with 0 missing
+        if(first == vector_end || (first >> 1) <= 0){
+            entry.genotypes[i] = 0;
+            continue;
+        }
+        if(second == vector_end || !(second & 1)){
+            entry.mark_unphased(i);
+            unphased = true;
+        }
+        entry.genotypes[i] = ((first >> 1) == 2) +
+            ((second != vector_end && (second >> 1) == 2) << 1);
+    }
+}
+
+bool BcfRecordSource::next_record(VcfFile &vcf_file, VcfEntry &entry){
+    while(read_record()){
+        TypedReader record(shared);
+        int32_t chromosome = record.read<int32_t>();
+        int32_t position = record.read<int32_t>();
+        record.take(8);  // rlen, qual
+        uint32_t n_allele_info = record.read<uint32_t>();
+        uint32_t n_fmt_sample = record.read<uint32_t>();
+        if(chromosome < 0 || (size_t)chromosome >= contigs.size())
+            throw std::invalid_argument("Invalid chromosome in bcf record");
+        if(entry.chromosome != contigs[chromosome])
+            entry.chromosome = contigs[chromosome];
+        entry.position = position + 1;
+
+        size_t length;
+        record.typed_value(length);  // ID
+        size_t n_allele = n_allele_info >> 16;
+        if(n_allele == 0 || n_allele > 2)
+            continue;
+        const char *reference = record.typed_value(length);
+        if(length != 1)
+            continue;
+        entry.reference = *reference;
+        entry.alternative = '.';  // no alternative allele
+        if(n_allele == 2){
+            const char *alternative = record.typed_value(length);
+            if(length != 1)
+                continue;
+            entry.alternative = *alternative;
+        }
+
+        std::fill(entry.unphased_individuals.begin(),
+                entry.unphased_individuals.end(), 0);
+        size_t n_fmt = n_fmt_sample >> 24, n_sample = n_fmt_sample & 0xffffff;
+        if(n_fmt == 0){
+            // a sites only record has every genotype missing
+            std::fill(entry.genotypes.begin(), entry.genotypes.end(), 0);
+            if(vcf_file.packs_haplotypes())
+                entry.pack_haplotypes();
+            return true;
+        }
+        if(n_sample != samples.size())
+            throw std::invalid_argument("Bcf record has the wrong number of samples");
+        TypedReader format(individual);
+        if(format.typed_int() != gt_key)
+            throw std::invalid_argument("FORMAT must start with GT");
+        int type;
+        size_t ploidy;
+        format.descriptor(type, ploidy);
+        const char *values = format.take(n_sample * ploidy * type_size(type));
+        bool unphased = false;
+        if(ploidy > 0){
+            switch(type){
+                case INT8:
+                    decode_gt<int8_t>(values, ploidy, columns, entry, unphased);
+                    break;
+                case INT16:
+                    decode_gt<int16_t>(values, ploidy, columns, entry, unphased);
+                    break;
+                case INT32:
+                    decode_gt<int32_t>(values, ploidy, columns, entry, unphased);
+                    break;
+                default:
+                    throw std::invalid_argument("GT must be an integer in bcf record");
+            }
+        }
+        if(unphased)
+            vcf_file.warn_unphased(entry);
+        if(vcf_file.packs_haplotypes())
+            entry.pack_haplotypes();
+        return true;
+    }
+    return false;
+}
+
+uint64_t BcfRecordSource::tell(){
+    auto bgzf = dynamic_cast<GzipStreamBuf*>(input.rdbuf());
+    if(bgzf != nullptr)
+        return bgzf->tell();
+    return input.tellg();
+}
+
+void BcfRecordSource::seek(uint64_t offset){
+    input.clear();
+    auto bgzf = dynamic_cast<GzipStreamBuf*>(input.rdbuf());
+    if(bgzf != nullptr)
+        bgzf->seek(offset);
+    else
+        input.seekg(offset);
+}
+
+std::vector<BcfChromosome> BcfRecordSource::scan_chromosomes(){
+    std::vector<BcfChromosome> result;
+    std::set<int32_t> seen;
+    int32_t last = -1;
+    for(;;){
+        uint64_t offset = tell();
+        if(!read_record())
+            break;
+        int32_t chromosome;
+        memcpy(&chromosome, shared.data(), sizeof(chromosome));
+        if(chromosome < 0 || (size_t)chromosome >= contigs.size())
+            throw std::invalid_argument("Invalid chromosome in bcf record");
+        if(chromosome == last)
+            continue;
+        if(!seen.insert(chromosome).second)
+            throw std::invalid_argument("Chromosome " + contigs[chromosome] +
+                    " is not contiguous in the vcf file");
+        result.push_back({contigs[chromosome], offset});
+        last = chromosome;
+    }
+    return result;
+}
@@ -0,0 +1,118 @@
+#include "sstar2/chromosome_runner.h"
+#include "sstar2/thread_pool.h"
+#include <set>
+#include <fstream>
+#include <mutex>
+#include <limits>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <stdlib.h>
+#include <unistd.h>
+
+std::vector<ChromosomeStart> index_chromosomes(const VcfIndex &index){
+    std::vector<ChromosomeStart> result;
+    for(const auto &chromosome : index.chromosomes()){
+        auto chunks = index.query(chromosome, 0,
+                std::numeric_limits<unsigned long>::max());
+        if(!chunks.empty())
+            result.push_back({chromosome, chunks.front().begin});
+    }
+    return result;
+}
+
+std::vector<ChromosomeStart> scan_chromosomes(std::istream &vcf,
+        GzipStreamBuf *input){
+    std::vector<ChromosomeStart> result;
+    std::set<std::string> seen;
+    std::string line;
+    uint64_t position = input == nullptr ? (uint64_t)vcf.tellg() : 0;
+
+    while(vcf.peek() == '#'){
+        std::getline(vcf, line);
+        position += line.size() + 1;
+    }
+    // only the chromosome of each line is needed
+    for(;;){
+        uint64_t start = input == nullptr ? position : input->tell();
+        if(!std::getline(vcf, line, '\t'))
+            break;
+        vcf.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        position += line.size() + 1 + vcf.gcount();
+        if(!result.empty() && result.back().chromosome == line)
+            continue;
+        if(!seen.insert(line).second)
+            throw std::invalid_argument("Chromosome " + line +
+                    " is not contiguous in the vcf file");
+        result.push_back({line, start});
+    }
+    return result;
+}
+
+// open an unnamed temporary file for reading and writing
+static void open_temporary(std::fstream &file){
+    const char *directory = getenv("TMPDIR");
+    std::string name = std::string(directory == nullptr ? "/tmp" : directory)
+        + "/sstar2_XXXXXX";
+    int descriptor = mkstemp(&name[0]);
+    if(descriptor == -1)
+        throw std::runtime_error("Unable to create temporary file in " + name);
+    close(descriptor);
+    file.open(name, std::ios::in | std::ios::out | std::ios::trunc |
+            std::ios::binary);
+    unlink(name.c_str());
+    if(!file.is_open())
+        throw std::runtime_error("Unable to open temporary file " + name);
+}
+
+void ChromosomeRunner::run(const std::vector<ChromosomeStart> &chromosomes,
+        std::ostream &output,
+        const std::function<void(const ChromosomeStart&, std::ostream&)> &process){
+    struct Part{
+        bool direct = false;
+        bool finished = false;
+        std::fstream file;
+    };
+    std::vector<Part> parts(chromosomes.size());
+    std::mutex mutex;
+    size_t next_write = 0;  // all earlier parts are in output
+    std::exception_ptr error;
+
+    ThreadPool pool(threads);
+    pool.parallel_for(chromosomes.size(), [&](size_t i, unsigned int){
+            Part &part = parts[i];
+            try{
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(error)
+                        return;
+                    part.direct = i == next_write;
+                    if(!part.direct)
+                        open_temporary(part.file);
+                }
+                process(chromosomes[i], part.direct ? output : part.file);
+
+                // write out finished parts in order
+                std::lock_guard<std::mutex> lock(mutex);
+                part.finished = true;
+                for( ; next_write < parts.size() && parts[next_write].finished;
+                        ++next_write){
+                    Part &next = parts[next_write];
+                    if(next.direct)
+                        continue;
+                    if(next.file.tellp() > 0){
+                        next.file.seekg(0);
+                        output << next.file.rdbuf();
+                    }
+                    next.file.close();
+                }
+            }
+            catch(...){
+                std::lock_guard<std::mutex> lock(mutex);
+                if(!error)
+                    error = std::current_exception();
+            }
+            });
+    if(error)
+        std::rethrow_exception(error);
+}
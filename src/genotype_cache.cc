@@ -0,0 +1,214 @@
+#include "sstar2/genotype_cache.h"
+#include <fstream>
+#include <stdexcept>
+#include <string.h>
+
+static const char MAGIC[8] = {'S', 'S', 'T', 'A', 'R', 'G', 'C', '\2'};
+
+// writes integers and padding, tracking the offset
+class CacheWriter{
+    std::ostream &output;
+
+    public:
+        uint64_t offset = 0;
+
+        CacheWriter(std::ostream &output) : output(output) {};
+        void write(const void *data, size_t length){
+            output.write((const char*)data, length);
+            offset += length;
+        }
+        template <typename T>
+        void write(T value){
+            write(&value, sizeof(T));
+        }
+        void write_name(const std::string &name){
+            write(name.c_str(), name.size() + 1);
+        }
+        void align(){
+            static const char zeros[8] = {0};
+            write(zeros, (8 - offset % 8) % 8);
+        }
+};
+
+void write_genotype_cache(RecordSource &input, std::ostream &output){
+    VcfFile vcf_file;
+    if(!input.read_header(vcf_file, {}))  // keep all samples
+        throw std::invalid_argument("No header line in the vcf file");
+    vcf_file.set_pack_haplotypes(true);
+    vcf_file.set_track_unphased(true);
+    VcfEntry entry = vcf_file.initialize_entry();
+    uint32_t words = entry.first_haplotype.size();
+
+    CacheWriter writer(output);
+    writer.write(MAGIC, sizeof(MAGIC));
+    writer.write((uint32_t)vcf_file.individual_map.size());
+    writer.write(words);
+    for(const auto &individual : vcf_file.individual_map)
+        writer.write_name(individual.second);
+    writer.align();
+
+    std::vector<CacheChromosome> chromosomes;
+    std::set<std::string> seen;
+    const char padding[6] = {0};
+    uint64_t record = 0;
+    for( ; input.next_record(vcf_file, entry); ++record){
+        if(chromosomes.empty() || chromosomes.back().name != entry.chromosome){
+            if(!seen.insert(entry.chromosome).second)
+                throw std::invalid_argument("Chromosome " + entry.chromosome +
+                        " is not contiguous in the vcf file");
+            chromosomes.push_back({entry.chromosome, record, 0});
+        }
+        ++chromosomes.back().records;
+        writer.write((uint64_t)entry.position);
+        writer.write(entry.reference);
+        writer.write(entry.alternative);
+        writer.write(padding, sizeof(padding));
+        writer.write(entry.first_haplotype.data(), words * sizeof(uint64_t));
+        writer.write(entry.second_haplotype.data(), words * sizeof(uint64_t));
+        // warned again when read, as the cache has lost the separators
+        writer.write(entry.unphased_individuals.data(), words * sizeof(uint64_t));
+    }
+
+    uint64_t table = writer.offset;
+    for(const auto &chromosome : chromosomes){
+        writer.write(chromosome.first);
+        writer.write(chromosome.records);
+        writer.write_name(chromosome.name);
+        writer.align();
+    }
+    writer.write((uint64_t)chromosomes.size());
+    writer.write(table);
+}
+
+bool is_genotype_cache(const std::string &filename){
+    std::ifstream input(filename, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    return input.read(magic, sizeof(magic)) &&
+        memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// reads from the mapped cache, throwing on truncation
+class CacheReader{
+    const char *data;
+    size_t size;
+
+    public:
+        size_t offset = 0;
+
+        CacheReader(const char *data, size_t size) : data(data), size(size) {};
+        void check(size_t length) const {
+            if(offset > size || size - offset < length)
+                throw std::invalid_argument("Genotype cache is truncated");
+        }
+        template <typename T>
+        T read(){
+            T value;
+            check(sizeof(T));
+            memcpy(&value, data + offset, sizeof(T));
+            offset += sizeof(T);
+            return value;
+        }
+        std::string read_name(){
+            check(1);
+            const char *end = (const char*)memchr(data + offset, '\0', size - offset);
+            if(end == nullptr)
+                throw std::invalid_argument("Genotype cache is truncated");
+            std::string result(data + offset, end);
+            offset = end - data + 1;
+            return result;
+        }
+        void align(){
+            offset += (8 - offset % 8) % 8;
+        }
+};
+
+GenotypeCache::GenotypeCache(const std::string &filename) : map(filename){
+    CacheReader reader(map.data, map.size);
+    reader.check(sizeof(MAGIC));
+    if(memcmp(map.data, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::invalid_argument(filename + " is not a genotype cache");
+    reader.offset = sizeof(MAGIC);
+    uint32_t nsamples = reader.read<uint32_t>();
+    words = reader.read<uint32_t>();
+    if(words != (nsamples + 63) / 64)
+        throw std::invalid_argument("Genotype cache has invalid sample count");
+    for(uint32_t i = 0; i < nsamples; ++i)
+        samples.push_back(reader.read_name());
+    reader.align();
+    stride = 16 + 3 * words * sizeof(uint64_t);
+    size_t records_offset = reader.offset;
+
+    reader.offset = map.size < 16 ? map.size : map.size - 16;
+    uint64_t nchromosomes = reader.read<uint64_t>();
+    uint64_t table = reader.read<uint64_t>();
+    if(table < records_offset || (table - records_offset) % stride != 0)
+        throw std::invalid_argument("Genotype cache has invalid records");
+    total_records = (table - records_offset) / stride;
+    records = map.data + records_offset;
+
+    reader.offset = table;
+    uint64_t expected_first = 0;
+    for(uint64_t i = 0; i < nchromosomes; ++i){
+        CacheChromosome chromosome;
+        chromosome.first = reader.read<uint64_t>();
+        chromosome.records = reader.read<uint64_t>();
+        chromosome.name = reader.read_name();
+        reader.align();
+        if(chromosome.first != expected_first ||
+                chromosome.records > total_records - chromosome.first)
+            throw std::invalid_argument("Genotype cache has invalid chromosomes");
+        expected_first += chromosome.records;
+        chromosome_table.push_back(chromosome);
+    }
+    if(expected_first != total_records)
+        throw std::invalid_argument("Genotype cache has invalid chromosomes");
+}
+
+bool GenotypeCache::read_header(VcfFile &vcf_file,
+        const std::set<std::string> &individuals){
+    vcf_file.initialize_individuals(samples, individuals);
+    columns.clear();
+    for(const auto &individual : vcf_file.individual_map)
+        columns.push_back(individual.first - 9);
+    return true;
+}
+
+bool GenotypeCache::next_record(VcfFile &vcf_file, VcfEntry &entry){
+    if(next >= total_records)
+        return false;
+    while(next >= chromosome_table[chromosome].first +
+            chromosome_table[chromosome].records)
+        ++chromosome;
+    const auto &name = chromosome_table[chromosome].name;
+    if(entry.chromosome != name)
+        entry.chromosome = name;
+
+    const char *record = records + next++ * stride;
+    uint64_t position;
+    memcpy(&position, record, sizeof(position));
+    entry.position = position;
+    entry.reference = record[8];
+    entry.alternative = record[9];
+    const uint64_t *first = (const uint64_t*)(record + 16);
+    const uint64_t *second = first + words;
+    const uint64_t *unphased = second + words;
+    for(size_t i = 0; i < columns.size(); ++i){
+        unsigned int word = columns[i] / 64, bit = columns[i] % 64;
+        entry.genotypes[i] = ((first[word] >> bit) & 1) |
+            (((second[word] >> bit) & 1) << 1);
+        // only selected individuals warn, as when parsing the vcf
+        if((unphased[word] >> bit) & 1)
+            vcf_file.warn_unphased(entry);
+    }
+    if(vcf_file.packs_haplotypes())
+        entry.pack_haplotypes();
+    return true;
+}
+
+void GenotypeCache::seek(uint64_t record){
+    next = record;
+    chromosome = 0;
+    while(chromosome + 1 < chromosome_table.size() &&
+            chromosome_table[chromosome + 1].first <= next)
+        ++chromosome;
+}
@@ -0,0 +1,99 @@
+#include "sstar2/genotype_kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SSTAR_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+static size_t decode_scalar(const char *start, const char *end,
+        size_t count, uint8_t *genotypes, bool &unphased){
+    size_t i = 0;
+    for( ; i < count && end - start > 3; ++i, start += 4){
+        if(start[3] != '\t' || start[0] == '\t' || start[1] == '\t' ||
+                start[2] == '\t')
+            break;
+        unphased |= start[0] != '.' && start[1] != '|';
+        genotypes[i] = start[0] == '.' ? 0 :
+            (start[0] == '1') + ((start[2] == '1') << 1);
+    }
+    return i;
+}
+
+// genotypes of the fields in a block from byte masks of the block,
+// with bit 4 * i being the first character of field i
+static inline void decode_masks(uint32_t ones, uint32_t dots, size_t fields,
+        uint8_t *genotypes){
+    for(size_t i = 0; i < fields; ++i, ones >>= 4, dots >>= 4)
+        genotypes[i] = (dots & 1) ? 0 : (ones & 1) | ((ones >> 1) & 2);
+}
+
+// separator bits of fields without a | which are not missing
+static inline uint32_t unphased_mask(uint32_t bars, uint32_t dots,
+        uint32_t separators){
+    return ~bars & ~(dots << 1) & separators;
+}
+
+#ifdef SSTAR_X86_KERNELS
+
+// 8 fields per 32 bytes, the block is regular when the only tabs end fields
+__attribute__((target("avx2")))
+static size_t decode_avx2(const char *start, const char *end,
+        size_t count, uint8_t *genotypes, bool &unphased){
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i bar = _mm256_set1_epi8('|');
+    const __m256i one = _mm256_set1_epi8('1');
+    const __m256i dot = _mm256_set1_epi8('.');
+
+    size_t i = 0;
+    for( ; i + 8 <= count && end - start >= 32; i += 8, start += 32){
+        __m256i block = _mm256_loadu_si256((const __m256i*)start);
+        uint32_t tabs = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, tab));
+        if(tabs != 0x88888888u)
+            break;
+        uint32_t bars = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, bar));
+        uint32_t dots = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, dot));
+        unphased |= unphased_mask(bars, dots, 0x22222222u) != 0;
+        decode_masks(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, one)),
+                dots, 8, genotypes + i);
+    }
+    return i;
+}
+
+// 4 fields per 16 bytes, only needs sse2
+static size_t decode_sse(const char *start, const char *end,
+        size_t count, uint8_t *genotypes, bool &unphased){
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i bar = _mm_set1_epi8('|');
+    const __m128i one = _mm_set1_epi8('1');
+    const __m128i dot = _mm_set1_epi8('.');
+
+    size_t i = 0;
+    for( ; i + 4 <= count && end - start >= 16; i += 4, start += 16){
+        __m128i block = _mm_loadu_si128((const __m128i*)start);
+        uint32_t tabs = _mm_movemask_epi8(_mm_cmpeq_epi8(block, tab));
+        if(tabs != 0x8888u)
+            break;
+        uint32_t bars = _mm_movemask_epi8(_mm_cmpeq_epi8(block, bar));
+        uint32_t dots = _mm_movemask_epi8(_mm_cmpeq_epi8(block, dot));
+        unphased |= unphased_mask(bars, dots, 0x2222u) != 0;
+        decode_masks(_mm_movemask_epi8(_mm_cmpeq_epi8(block, one)),
+                dots, 4, genotypes + i);
+    }
+    return i;
+}
+
+#endif
+
+size_t decode_genotypes(SimdLevel level, const char *start, const char *end,
+        size_t count, uint8_t *genotypes, bool &unphased){
+    size_t i = 0;
+#ifdef SSTAR_X86_KERNELS
+    if(level == SimdLevel::avx2)
+        i = decode_avx2(start, end, count, genotypes, unphased);
+    if(level != SimdLevel::scalar)
+        i += decode_sse(start + 4 * i, end, count - i, genotypes + i, unphased);
+#endif
+    // remainder of the run, or the first irregular block
+    return i + decode_scalar(start + 4 * i, end, count - i,
+            genotypes + i, unphased);
+}
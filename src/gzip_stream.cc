@@ -0,0 +1,259 @@
+#include "sstar2/gzip_stream.h"
+#include <stdexcept>
+#include <atomic>
+#include <algorithm>
+
+bool is_gzipped(std::istream &input){
+    return input.rdbuf()->sgetc() == 0x1f;
+}
+
+// little endian unsigned values from raw bytes
+static unsigned int read_le(const char *bytes, int length){
+    unsigned int result = 0;
+    for(int i = length - 1; i >= 0; --i)
+        result = (result << 8) | (unsigned char)bytes[i];
+    return result;
+}
+
+GzipStreamBuf::GzipStreamBuf(std::istream &input, unsigned int threads) :
+    input(input), pool(std::max(threads, 1u)),
+    batch_size(16 * std::max(threads, 1u)) {
+        next_address = std::max<std::streamoff>(input.tellg(), 0);
+        start_address = next_address;
+        read_header();
+        if(bgzf){
+            batch.resize(batch_size);
+            next_batch.resize(batch_size);
+            pending = std::async(std::launch::async,
+                    &GzipStreamBuf::read_batch, this, std::ref(next_batch));
+        }
+        else{
+            stream.zalloc = Z_NULL;
+            stream.zfree = Z_NULL;
+            stream.opaque = Z_NULL;
+            stream.next_in = Z_NULL;
+            stream.avail_in = 0;
+            if(inflateInit2(&stream, 15 + 16) != Z_OK)
+                throw std::runtime_error("Unable to initialize zlib");
+            stream_open = true;
+            in_buffer.resize(1 << 16);
+            out_buffer.resize(1 << 16);
+        }
+}
+
+GzipStreamBuf::~GzipStreamBuf(){
+    if(pending.valid())
+        pending.wait();
+    if(stream_open)
+        inflateEnd(&stream);
+}
+
+void GzipStreamBuf::read_header(){
+    // reads the fixed header and extra field of the first member, bgzf
+    // members have a BC subfield with the block size
+    char fixed[12];
+    input.read(fixed, 12);
+    if(input.gcount() != 12 || (unsigned char)fixed[0] != 0x1f ||
+            (unsigned char)fixed[1] != 0x8b || fixed[2] != 8)
+        throw std::invalid_argument("Input is not gzip compressed");
+    header.assign(fixed, 12);
+    if((fixed[3] & 4) == 0)  // no extra field
+        return;
+
+    std::vector<char> extra(read_le(fixed + 10, 2));
+    input.read(extra.data(), extra.size());
+    if((size_t)input.gcount() != extra.size())
+        throw std::invalid_argument("Truncated gzip header");
+    header.append(extra.begin(), extra.end());
+    for(size_t i = 0; i + 4 <= extra.size(); i += 4 + read_le(&extra[i+2], 2))
+        if(extra[i] == 'B' && extra[i+1] == 'C' && read_le(&extra[i+2], 2) == 2)
+            bgzf = true;
+}
+
+bool GzipStreamBuf::read_block(Block &block){
+    // read the next raw bgzf block, false at end of input
+    std::string head;
+    if(!header.empty())
+        head.swap(header);
+    else{
+        char fixed[12];
+        input.read(fixed, 12);
+        if(input.gcount() == 0)
+            return false;
+        if(input.gcount() != 12)
+            throw std::runtime_error("Truncated bgzf block");
+        head.assign(fixed, 12);
+        head.resize(12 + read_le(fixed + 10, 2));
+        input.read(&head[12], head.size() - 12);
+        if((size_t)input.gcount() != head.size() - 12)
+            throw std::runtime_error("Truncated bgzf block");
+    }
+
+    block.address = next_address;
+    long block_size = -1;
+    for(size_t i = 12; i + 6 <= head.size(); i += 4 + read_le(&head[i+2], 2))
+        if(head[i] == 'B' && head[i+1] == 'C' && read_le(&head[i+2], 2) == 2)
+            block_size = read_le(&head[i+4], 2) + 1;
+    if(block_size < (long)head.size() + 8)
+        throw std::runtime_error("Malformed bgzf block header");
+
+    block.compressed.resize(block_size - head.size());
+    input.read(block.compressed.data(), block.compressed.size());
+    if((size_t)input.gcount() != block.compressed.size())
+        throw std::runtime_error("Truncated bgzf block");
+    // bgzf blocks hold at most 64 KiB, so a larger size is corrupt
+    unsigned int data_size = read_le(&block.compressed[block.compressed.size() - 4], 4);
+    if(data_size > 65536)
+        throw std::runtime_error("Malformed bgzf block");
+    block.data.resize(data_size);
+    next_address += block_size;
+    return true;
+}
+
+// inflate a raw block, checking the size and crc from its trailer
+static bool inflate_block(std::vector<char> &compressed, std::vector<char> &data){
+    z_stream block_stream;
+    block_stream.zalloc = Z_NULL;
+    block_stream.zfree = Z_NULL;
+    block_stream.opaque = Z_NULL;
+    if(inflateInit2(&block_stream, -15) != Z_OK)
+        return false;
+    char empty;
+    block_stream.next_in = (Bytef*)compressed.data();
+    block_stream.avail_in = compressed.size() - 8;
+    block_stream.next_out = (Bytef*)(data.empty() ? &empty : data.data());
+    block_stream.avail_out = data.size();
+    int result = inflate(&block_stream, Z_FINISH);
+    bool complete = result == Z_STREAM_END && block_stream.avail_out == 0;
+    inflateEnd(&block_stream);
+
+    unsigned long crc = crc32(0L, (const Bytef*)data.data(), data.size());
+    return complete &&
+        crc == read_le(&compressed[compressed.size() - 8], 4);
+}
+
+size_t GzipStreamBuf::read_batch(std::vector<Block> &blocks){
+    // read raw blocks sequentially then inflate them in parallel
+    size_t count = 0;
+    while(count < blocks.size() && read_block(blocks[count]))
+        ++count;
+    std::atomic<bool> failed{false};
+    pool.parallel_for(count, [&](size_t i, unsigned int){
+            if(!inflate_block(blocks[i].compressed, blocks[i].data))
+                failed = true;
+            });
+    if(failed)
+        throw std::runtime_error("Unable to decompress bgzf block");
+    return count;
+}
+
+bool GzipStreamBuf::next_bgzf(){
+    for(;;){
+        if(current_block < batch_blocks){
+            Block &block = batch[current_block++];
+            if(block.data.empty())
+                continue;
+            setg(block.data.data(), block.data.data(),
+                    block.data.data() + block.data.size());
+            return true;
+        }
+        if(!pending.valid())
+            return false;
+        // swap in the prefetched batch and start on the following one
+        batch_blocks = pending.get();
+        if(batch_blocks == 0)
+            return false;
+        std::swap(batch, next_batch);
+        current_block = 0;
+        pending = std::async(std::launch::async,
+                &GzipStreamBuf::read_batch, this, std::ref(next_batch));
+    }
+}
+
+void GzipStreamBuf::seek(uint64_t virtual_offset){
+    if(!bgzf)
+        throw std::logic_error("Only bgzf input can be seeked");
+    // discard the batch being prefetched, it may have failed past the end
+    if(pending.valid())
+        pending.wait();
+    pending = std::future<size_t>();
+    header.clear();
+    batch_blocks = current_block = 0;
+    setg(nullptr, nullptr, nullptr);
+
+    input.clear();
+    input.seekg(virtual_offset >> 16);
+    if(!input)
+        throw std::runtime_error("Unable to seek in bgzf input");
+    next_address = start_address = virtual_offset >> 16;
+    pending = std::async(std::launch::async,
+            &GzipStreamBuf::read_batch, this, std::ref(next_batch));
+
+    size_t offset = virtual_offset & 0xffff;
+    if(offset == 0)
+        return;
+    if(!next_bgzf() || offset > (size_t)(egptr() - gptr()))
+        throw std::runtime_error("Invalid bgzf virtual offset");
+    gbump(offset);
+}
+
+uint64_t GzipStreamBuf::tell() const{
+    if(!bgzf)
+        throw std::logic_error("Only bgzf input has virtual offsets");
+    if(gptr() == nullptr)  // nothing read since construction or a seek
+        return start_address << 16;
+    return batch[current_block - 1].address << 16 | (gptr() - eback());
+}
+
+bool GzipStreamBuf::next_gzip(){
+    if(stream_finished)
+        return false;
+    for(;;){
+        if(stream.avail_in == 0){
+            size_t count;
+            if(!header.empty()){
+                // an extra field can make the header longer than a read
+                count = header.size();
+                if(in_buffer.size() < count)
+                    in_buffer.resize(count);
+                std::copy(header.begin(), header.end(), in_buffer.begin());
+                header.clear();
+            }
+            else{
+                input.read(in_buffer.data(), in_buffer.size());
+                count = input.gcount();
+            }
+            if(count == 0){
+                stream_finished = true;
+                if(stream.total_in != 0)  // stopped inside a member
+                    throw std::runtime_error("Truncated gzip input");
+                return false;
+            }
+            stream.next_in = (Bytef*)in_buffer.data();
+            stream.avail_in = count;
+        }
+
+        stream.next_out = (Bytef*)out_buffer.data();
+        stream.avail_out = out_buffer.size();
+        int result = inflate(&stream, Z_NO_FLUSH);
+        if(result == Z_STREAM_END)  // allow concatenated members
+            inflateReset(&stream);
+        else if(result != Z_OK)
+            throw std::runtime_error("Unable to decompress gzip input");
+
+        size_t produced = out_buffer.size() - stream.avail_out;
+        if(produced > 0){
+            setg(out_buffer.data(), out_buffer.data(),
+                    out_buffer.data() + produced);
+            return true;
+        }
+    }
+}
+
+GzipStreamBuf::int_type GzipStreamBuf::underflow(){
+    if(gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+    if(!(bgzf ? next_bgzf() : next_gzip()))
+        return traits_type::eof();
+    return traits_type::to_int_type(*gptr());
+}
@@ -0,0 +1,71 @@
+#include "sstar2/line_source.h"
+#include <stdexcept>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+bool IstreamLineSource::next_line(const char *&line, size_t &length){
+    if(!std::getline(input, buffer))
+        return false;
+    line = buffer.data();
+    length = buffer.size();
+    return true;
+}
+
+void IstreamLineSource::seek(uint64_t offset){
+    input.clear();
+    auto bgzf = dynamic_cast<GzipStreamBuf*>(input.rdbuf());
+    if(bgzf != nullptr)
+        bgzf->seek(offset);
+    else
+        input.seekg(offset);
+}
+
+MemoryMap::MemoryMap(const std::string &filename){
+    int descriptor = open(filename.c_str(), O_RDONLY);
+    if(descriptor == -1)
+        throw std::runtime_error("Unable to open " + filename);
+    struct stat status;
+    if(fstat(descriptor, &status) == -1){
+        close(descriptor);
+        throw std::runtime_error("Unable to stat " + filename);
+    }
+    size = status.st_size;
+    if(size > 0){
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if(mapping == MAP_FAILED){
+            close(descriptor);
+            throw std::runtime_error("Unable to memory map " + filename);
+        }
+        // read ahead aggressively and drop pages behind
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = (const char*)mapping;
+    }
+    close(descriptor);  // mapping remains valid
+}
+
+MemoryMap::~MemoryMap(){
+    if(data != nullptr)
+        munmap((void*)data, size);
+}
+
+bool MmapLineSource::next_line(const char *&line, size_t &length){
+    if(position >= map.size)
+        return false;
+    line = map.data + position;
+    const char *end = (const char*)memchr(line, '\n', map.size - position);
+    length = end == nullptr ? map.size - position : end - line;
+    position += length + 1;
+    return true;
+}
+
+void MmapLineSource::seek(uint64_t offset){
+    position = offset;
+}
+
+bool can_mmap(const std::string &filename){
+    struct stat status;
+    return stat(filename.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+}
@@ -3,20 +3,145 @@
 #include <fstream>
 #include <stdlib.h>
 #include <set>
+#include <algorithm>
+#include <atomic>
 
 #include <CLI/CLI.hpp>
 
 #include "sstar2/sstar.h"
+#include "sstar2/window_pipeline.h"
 #include "sstar2/window_generator.h"
 #include "sstar2/validator.h"
+#include "sstar2/gzip_stream.h"
+#include "sstar2/vcf_index.h"
+#include "sstar2/chromosome_runner.h"
+#include "sstar2/line_source.h"
+#include "sstar2/record_source.h"
+#include "sstar2/genotype_cache.h"
+#include "sstar2/bcf_reader.h"
+#include "sstar2/batch_config.h"
+#include "sstar2/shared_records.h"
+
+// a vcf file opened for reading, decompressing gzip input
+struct VcfInput{
+    std::ifstream file;
+    std::unique_ptr<GzipStreamBuf> gzip;
+    std::istream stream{nullptr};
+    bool seekable;
+    bool bcf;
+
+    VcfInput(const std::string &filename, unsigned int threads){
+        file.open(filename, std::ios::binary);
+        seekable = file.tellg() != -1;  // false for pipes
+        stream.rdbuf(file.rdbuf());
+        if(is_gzipped(file)){
+            gzip.reset(new GzipStreamBuf(file, threads));
+            stream.rdbuf(gzip.get());
+            // report decompression errors instead of stopping early
+            stream.exceptions(std::ios::badbit);
+        }
+        bcf = is_bcf(stream);
+    }
+    bool is_bgzf() const { return gzip && gzip->is_bgzf(); }
+
+    // records of the input, reading uncompressed vcf files directly
+    // from memory
+    std::unique_ptr<RecordSource> records(const std::string &filename){
+        if(bcf)
+            return std::unique_ptr<RecordSource>(new BcfRecordSource(stream));
+        std::unique_ptr<LineSource> lines;
+        if(!gzip && seekable && can_mmap(filename))
+            lines.reset(new MmapLineSource(filename));
+        else
+            lines.reset(new IstreamLineSource(stream));
+        return std::unique_ptr<RecordSource>(new VcfRecordSource(std::move(lines)));
+    }
+};
+
+// bed files stacked into one validator, a position must be in every include
+// bed and no exclude bed.  Streams are kept for the life of the generator
+struct BedFiles{
+    std::vector<std::unique_ptr<std::ifstream>> streams;
+
+    // false after reporting the first file which can not be opened
+    static bool can_open(const std::vector<std::string> &include,
+            const std::vector<std::string> &exclude){
+        for(const auto *beds : {&include, &exclude})
+            for(const auto &filename : *beds)
+                if(!std::ifstream(filename).is_open()){
+                    std::cerr << "Unable to open " << filename << "\n";
+                    return false;
+                }
+        return true;
+    }
+
+    // false after reporting a file which can not be opened
+    bool add_to(WindowGenerator &generator,
+            const std::vector<std::string> &include,
+            const std::vector<std::string> &exclude){
+        std::vector<std::unique_ptr<Validator>> validators;
+        for(size_t i = 0; i < include.size() + exclude.size(); ++i){
+            bool included = i < include.size();
+            const std::string &filename = included ?
+                include[i] : exclude[i - include.size()];
+            streams.emplace_back(new std::ifstream(filename));
+            if(!streams.back()->is_open()){
+                std::cerr << "Unable to open " << filename << "\n";
+                return false;
+            }
+            if(included)
+                validators.emplace_back(new PositiveBedValidator(streams.back().get()));
+            else
+                validators.emplace_back(new NegativeBedValidator(streams.back().get()));
+        }
+        if(!validators.empty())
+            generator.add_validator(std::unique_ptr<Validator>(
+                        new MaskValidator(std::move(validators))));
+        return true;
+    }
+};
+
+// sstar2 convert, write a genotype cache of a vcf for repeated runs
+int convert(int argc, char** argv)
+{
+    CLI::App app{"Convert a vcf to a genotype cache, which can be given "
+        "to --vcf in place of the vcf"};
+
+    std::string vcf_file;
+    app.add_option("-v,--vcf", vcf_file,
+            "Input vcf or bcf file, optionally gzip or bgzip compressed; "
+            "can accept input redirection")
+        ->required()->check(CLI::ExistingFile);
+    std::string outfile;
+    app.add_option("-o,--output", outfile, "Output genotype cache")
+        ->required();
+    unsigned int threads = 1;
+    app.add_option("--threads", threads,
+            "Number of threads for decompressing bgzip input; default 1");
+
+    CLI11_PARSE(app, argc, argv);
+
+    std::ofstream output(outfile, std::ios::binary);
+    if(!output.is_open()){
+        std::cerr << "Unable to open " << outfile << "\n";
+        return 1;
+    }
+    VcfInput vcf(vcf_file, threads);
+    write_genotype_cache(*vcf.records(vcf_file), output);
+    return 0;
+}
 
 int main(int argc, char** argv)
 {
+    if(argc > 1 && std::string(argv[1]) == "convert")
+        return convert(argc - 1, argv + 1);
+
     CLI::App app{"Fast, lean sstar rewrite"};
 
     std::string vcf_file;
     app.add_option("-v,--vcf", vcf_file,
-            "Input vcf file; can accept input redirection")
+            "Input vcf or bcf file, optionally gzip or bgzip compressed, or "
+            "a genotype cache from sstar2 convert; can accept input redirection")
         ->required()->check(CLI::ExistingFile);
     std::string popfile;
     app.add_option("-p,--popfile", popfile,
@@ -24,13 +149,15 @@ int main(int argc, char** argv)
         ->required()->check(CLI::ExistingFile);
 
     std::vector<std::string> targets, references, excluded;
-    app.add_option("-t,--targets", targets,
-            "Comma separated list of target populations or individuals")
-        ->required()->delimiter(',');
+    auto targets_option = app.add_option("-t,--targets", targets,
+            "Comma separated list of target populations or individuals; "
+            "required without --batch")
+        ->delimiter(',');
 
-    app.add_option("-r,--references", references,
-            "Comma separated list of reference populations or individuals")
-        ->required()->delimiter(',');
+    auto references_option = app.add_option("-r,--references", references,
+            "Comma separated list of reference populations or individuals; "
+            "required without --batch")
+        ->delimiter(',');
 
     app.add_option("-e,--excluded", excluded,
             "Comma separated list of excluded populations or individuals; default to none excluded")
@@ -40,29 +167,83 @@ int main(int argc, char** argv)
     app.add_option("-l,--length", length, "Window length; default 50,000");
     app.add_option("-s,--step", step, "Window step; default 10,000");
 
-    int bonus = 5000, penalty = -10000;
-    app.add_option("--match-bonus", bonus, "Match bonus for sstar; default 5000");
-    app.add_option("--mismatch-penalty", penalty, "Mismatch penalty for sstar; default -10000");
+    std::vector<long> bonuses{5000}, penalties{-10000};
+    app.add_option("--match-bonus", bonuses,
+            "Match bonus for sstar, or a comma separated list to score every "
+            "pair of bonus and penalty in one run, adding match_bonus and "
+            "mismatch_penalty columns; default 5000")
+        ->delimiter(',');
+    app.add_option("--mismatch-penalty", penalties,
+            "Mismatch penalty for sstar, or a comma separated list as for "
+            "--match-bonus; default -10000")
+        ->delimiter(',');
 
-    std::string positiveBed = "";
-    app.add_option("--include-bed", positiveBed,
-            "Bed file with regions to include")
+    std::vector<std::string> positiveBeds;
+    app.add_option("--include-bed", positiveBeds,
+            "Bed files with regions to include; with several, only regions "
+            "in every file are included")
         ->check(CLI::ExistingFile);
 
-    std::string negativeBed = "";
-    app.add_option("--exclude-bed", negativeBed,
-            "Bed file with regions to exclude")
+    std::vector<std::string> negativeBeds;
+    app.add_option("--exclude-bed", negativeBeds,
+            "Bed files with regions to exclude; with several, regions in "
+            "any file are excluded")
         ->check(CLI::ExistingFile);
 
+    std::string regions = "";
+    app.add_option("--regions", regions,
+            "Only score windows in regions, given as [chrom:]start-end or a "
+            "file with chrom, start and end columns");
+
+    std::string index_file = "";
+    app.add_option("--index", index_file,
+            "Tabix or csi index of a bgzip compressed vcf, used to read only "
+            "the --regions and find chromosomes; default to the vcf with .tbi "
+            "or .csi appended if present")
+        ->check(CLI::ExistingFile);
+
+    unsigned int threads = 1;
+    app.add_option("--threads", threads,
+            "Number of threads for scoring targets and decompressing "
+            "bgzip input; default 1");
+
+    unsigned int windows_in_flight = 0;
+    auto in_flight_option = app.add_option("--windows-in-flight", windows_in_flight,
+            "Overlap reading, scoring and writing with this many windows "
+            "held in memory, scoring windows on --threads workers; "
+            "default 0 (serial)");
+
+    unsigned int parallel_chromosomes = 1;
+    auto parallel_option = app.add_option("--parallel-chromosomes", parallel_chromosomes,
+            "Number of chromosomes to process at once, each using --threads; "
+            "chromosomes are found from the index or by scanning the vcf; "
+            "default 1");
+
+    bool stats = false;
+    app.add_flag("--stats", stats,
+            "Report how many target windows were scored and how many reused "
+            "the scores of a target with identical genotypes");
+
     std::string outfile = "-";
-    app.add_option("-o,--output", outfile,
+    auto output_option = app.add_option("-o,--output", outfile,
             "Output file; can accept input redirection; default stdout");
 
+    std::string batch_file = "";
+    app.add_option("--batch", batch_file,
+            "File of analyses, each with its own targets, references, "
+            "excluded, bed files and output, run on a single pass over the "
+            "vcf; --excluded and bed files apply to analyses without their own")
+        ->check(CLI::ExistingFile)
+        ->excludes(targets_option)->excludes(references_option)
+        ->excludes(output_option)->excludes(in_flight_option)
+        ->excludes(parallel_option);
+
     CLI11_PARSE(app, argc, argv);
 
-    std::ifstream vcf, popdata, posBed, negBed;
-    vcf.open(vcf_file);
-    popdata.open(popfile);
+    if(batch_file == "" && (targets.empty() || references.empty())){
+        std::cerr << "--targets and --references are required\n";
+        return 1;
+    }
 
     std::set<std::string> target_set, reference_set, excluded_set;
     for (const auto &indiv : targets)
@@ -85,31 +266,251 @@ int main(int argc, char** argv)
     }
     std::ostream output(buf);
 
-    WindowGenerator generator(std::unique_ptr<Window>(new StepWindow(step, length)));
-    generator.initialize(vcf, popdata, target_set, reference_set, excluded_set);
+    VcfInput vcf(vcf_file, threads);
+    // caches are memory mapped, so not read from pipes
+    bool cached = can_mmap(vcf_file) && is_genotype_cache(vcf_file);
+
+    // targets scored and reused across all windows, see --stats
+    std::atomic<uint64_t> targets_scored{0}, targets_reused{0};
+    auto add_stats = [&](const SStarCaller &sstar){
+        targets_scored += sstar.targets_scored();
+        targets_reused += sstar.targets_reused();
+    };
+    auto report_stats = [&](){
+        if(!stats)
+            return;
+        uint64_t total = targets_scored + targets_reused;
+        std::cerr << "Scored " << targets_scored << " of " << total
+            << " target windows, " << targets_reused << " ("
+            << (total == 0 ? 0.0 : 100.0 * targets_reused / total)
+            << "%) reused an identical target\n";
+    };
+
+    auto make_window = [&](){
+        std::unique_ptr<Window> window;
+        if(regions != ""){
+            std::ifstream region_file(regions);
+            if(region_file.is_open())
+                window.reset(new RangedWindow(step, length, region_file));
+            else
+                window.reset(new RangedWindow(step, length, regions));
+        }
+        else
+            window.reset(new StepWindow(step, length));
+        return window;
+    };
+
+    if(batch_file != ""){
+        std::ifstream batch_input(batch_file);
+        std::vector<Analysis> analyses;
+        try{
+            analyses = read_batch_config(batch_input);
+        }
+        catch(const std::invalid_argument &error){
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+
+        // parse the vcf once for every individual of the analyses
+        std::set<std::string> individuals;
+        for(auto &analysis : analyses){
+            if(analysis.excluded.empty())
+                analysis.excluded = excluded;
+            if(analysis.include_beds.empty())
+                analysis.include_beds = positiveBeds;
+            if(analysis.exclude_beds.empty())
+                analysis.exclude_beds = negativeBeds;
+            std::set<std::string> target(analysis.targets.begin(), analysis.targets.end()),
+                reference(analysis.references.begin(), analysis.references.end()),
+                exclude(analysis.excluded.begin(), analysis.excluded.end());
+            std::ifstream popdata(popfile);
+            PopulationData population;
+            population.read_data(popdata, target, reference, exclude);
+            individuals.insert(population.targets.begin(), population.targets.end());
+            individuals.insert(population.references.begin(), population.references.end());
+            individuals.insert(population.excluded.begin(), population.excluded.end());
+        }
+        std::unique_ptr<RecordSource> records;
+        if(cached)
+            records.reset(new GenotypeCache(vcf_file));
+        else
+            records = vcf.records(vcf_file);
+        SharedRecords shared(std::move(records), individuals);
 
-    // add validators
-    if(positiveBed != ""){
-        posBed.open(positiveBed);
-        generator.add_validator(std::unique_ptr<Validator>(
-                    new PositiveBedValidator(&posBed)));
+        struct BatchRun{
+            WindowGenerator generator;
+            SStarCaller sstar;
+            SharedRecordReader *records;
+            BedFiles beds;
+            std::ofstream output;
+            BatchRun(std::unique_ptr<Window> window,
+                    const std::vector<long> &bonuses,
+                    const std::vector<long> &penalties) :
+                generator(std::move(window)), sstar(bonuses, penalties) {};
+        };
+        // generators read their first record when initialized
+        std::vector<std::unique_ptr<SharedRecordReader>> readers;
+        for(size_t i = 0; i < analyses.size(); ++i)
+            readers.push_back(shared.reader());
+        std::vector<std::unique_ptr<BatchRun>> runs;
+        for(const auto &analysis : analyses){
+            runs.emplace_back(new BatchRun(make_window(), bonuses, penalties));
+            BatchRun &run = *runs.back();
+            auto &reader = readers[runs.size() - 1];
+            run.records = reader.get();
+            std::set<std::string> target(analysis.targets.begin(), analysis.targets.end()),
+                reference(analysis.references.begin(), analysis.references.end()),
+                exclude(analysis.excluded.begin(), analysis.excluded.end());
+            std::ifstream popdata(popfile);
+            run.generator.initialize(std::move(reader), popdata,
+                    target, reference, exclude);
+
+            if(!run.beds.add_to(run.generator,
+                        analysis.include_beds, analysis.exclude_beds))
+                return 1;
+
+            run.output.open(analysis.output);
+            if(!run.output.is_open()){
+                std::cerr << "Unable to open " << analysis.output << "\n";
+                return 1;
+            }
+            run.sstar.write_header(run.output);
+            run.sstar.set_threads(threads);
+        }
+
+        // step the analysis furthest behind in the vcf, bounding the
+        // records held for it
+        std::vector<BatchRun*> active;
+        for(auto &run : runs)
+            active.push_back(run.get());
+        while(!active.empty()){
+            auto slowest = std::min_element(active.begin(), active.end(),
+                    [](const BatchRun *a, const BatchRun *b){
+                        return a->records->position() < b->records->position();
+                    });
+            BatchRun &run = **slowest;
+            if(run.generator.next_window())
+                run.sstar.write_window(run.output, run.generator);
+            else
+                active.erase(slowest);
+        }
+        for(const auto &run : runs)
+            add_stats(run->sstar);
+        report_stats();
+        return 0;
     }
 
-    if(negativeBed != ""){
-        negBed.open(negativeBed);
-        generator.add_validator(std::unique_ptr<Validator>(
-                    new NegativeBedValidator(&negBed)));
+    // seek to regions and chromosomes instead of reading the whole file
+    std::unique_ptr<VcfIndex> index;
+    bool seeking = regions != "" || parallel_chromosomes > 1;
+    if(seeking && index_file == "" && vcf.is_bgzf() && !vcf.bcf)
+        index_file = find_index(vcf_file);
+    if(seeking && index_file != ""){
+        if(!vcf.is_bgzf() || vcf.bcf){
+            std::cerr << "An index requires a bgzip compressed vcf\n";
+            return 1;
+        }
+        std::ifstream index_input(index_file, std::ios::binary);
+        try{
+            index.reset(new VcfIndex(index_input));
+        }
+        catch(const std::exception &error){
+            std::cerr << "Unable to read index " << index_file << ": "
+                << error.what() << "\n";
+            return 1;
+        }
     }
 
-    SStarCaller sstar{bonus, penalty};
-    sstar.write_header(output);
+    // each chromosome opens the beds again, so check them once here
+    if(!BedFiles::can_open(positiveBeds, negativeBeds))
+        return 1;
+
+    // warned once for the run, not for each chromosome
+    std::atomic<bool> warned_unphased{false};
+
+    // read the vcf, or one chromosome of it, writing windows to out
+    auto process = [&](VcfInput &input, const ChromosomeStart *chromosome,
+            std::ostream &out){
+        WindowGenerator generator(make_window());
+        generator.vcf_file.share_unphased_warning(warned_unphased);
+
+        if(index)
+            generator.set_index(*index);
+        if(chromosome != nullptr)
+            generator.set_chromosome(chromosome->chromosome, chromosome->offset);
+
+        std::ifstream popdata(popfile);
+        std::unique_ptr<RecordSource> records;
+        if(cached)
+            records.reset(new GenotypeCache(vcf_file));
+        else
+            records = input.records(vcf_file);
+        generator.initialize(std::move(records), popdata,
+                target_set, reference_set, excluded_set);
 
-    while (generator.next_window())
-        sstar.write_window(output, generator);
+        // add validators
+        BedFiles beds;
+        if(!beds.add_to(generator, positiveBeds, negativeBeds))
+            throw std::runtime_error("Unable to open bed files");
+
+        SStarCaller sstar{bonuses, penalties};
+        if (windows_in_flight > 0){
+            WindowPipeline pipeline(sstar, threads, windows_in_flight);
+            pipeline.run(generator, out);
+        }
+        else{
+            sstar.set_threads(threads);
+            while (generator.next_window())
+                sstar.write_window(out, generator);
+        }
+        add_stats(sstar);
+    };
+
+    // find where chromosomes start to process them independently
+    std::vector<ChromosomeStart> chromosomes;
+    if(parallel_chromosomes > 1){
+        if(vcf.gzip && !vcf.is_bgzf()){
+            std::cerr << "Parallel chromosomes require an uncompressed "
+                "or bgzip compressed vcf\n";
+            return 1;
+        }
+        if(!vcf.seekable){
+            std::cerr << "Parallel chromosomes require a vcf file, "
+                "not a stream\n";
+            return 1;
+        }
+        if(cached){
+            GenotypeCache cache(vcf_file);
+            for(const auto &chromosome : cache.chromosomes())
+                chromosomes.push_back({chromosome.name, chromosome.first});
+        }
+        else if(vcf.bcf){
+            VcfFile header;
+            BcfRecordSource bcf(vcf.stream);
+            bcf.read_header(header, {});
+            for(const auto &chromosome : bcf.scan_chromosomes())
+                chromosomes.push_back({chromosome.name, chromosome.offset});
+        }
+        else
+            chromosomes = index ? index_chromosomes(*index) :
+                scan_chromosomes(vcf.stream, vcf.gzip.get());
+    }
+
+    SStarCaller{bonuses, penalties}.write_header(output);
+
+    if(parallel_chromosomes > 1){
+        ChromosomeRunner runner(parallel_chromosomes);
+        runner.run(chromosomes, output,
+                [&](const ChromosomeStart &chromosome, std::ostream &out){
+                    VcfInput input(vcf_file, threads);
+                    process(input, &chromosome, out);
+                });
+    }
+    else
+        process(vcf, nullptr, output);
 
-    vcf.close();
-    popdata.close();
     if(of.is_open())
         of.close();
+    report_stats();
     return 0;
 }
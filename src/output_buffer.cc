@@ -0,0 +1,42 @@
+#include "sstar2/output_buffer.h"
+#include <string.h>
+
+// two digits at a time, "00" to "99"
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+void OutputBuffer::append_unsigned(unsigned long long value){
+    char digits[20];  // enough for 2^64
+    char *end = digits + sizeof(digits), *start = end;
+    while(value >= 100){
+        unsigned int pair = (value % 100) * 2;
+        value /= 100;
+        start -= 2;
+        memcpy(start, digit_pairs + pair, 2);
+    }
+    if(value >= 10){
+        start -= 2;
+        memcpy(start, digit_pairs + value * 2, 2);
+    }
+    else
+        *--start = '0' + value;
+    text.append(start, end - start);
+}
+
+void OutputBuffer::append_signed(long long value){
+    if(value < 0){
+        text.push_back('-');
+        // negate as unsigned, which is defined for the minimum value
+        append_unsigned(0ull - (unsigned long long)value);
+    }
+    else
+        append_unsigned(value);
+}
+
+void OutputBuffer::flush(std::ostream &output){
+    output.write(text.data(), text.size());
+    text.clear();
+}
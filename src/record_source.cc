@@ -0,0 +1,24 @@
+#include "sstar2/record_source.h"
+
+bool VcfRecordSource::read_header(VcfFile &vcf_file,
+        const std::set<std::string> &individuals){
+    const char *line;
+    size_t length;
+    while(lines->next_line(line, length)){
+        if(length < 2 || line[1] != '#'){
+            // setup indiviual mapping
+            vcf_file.initialize_individuals(std::string(line, length), individuals);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VcfRecordSource::next_record(VcfFile &vcf_file, VcfEntry &entry){
+    const char *line;
+    size_t length;
+    while(lines->next_line(line, length))
+        if(vcf_file.parse_line(line, length, entry))
+            return true;
+    return false;
+}
@@ -0,0 +1,103 @@
+#include "sstar2/shared_records.h"
+#include <algorithm>
+#include <stdexcept>
+
+SharedRecords::SharedRecords(std::unique_ptr<RecordSource> input,
+        const std::set<std::string> &individuals) : source(std::move(input)){
+    has_header = source->read_header(vcf_file, individuals);
+    input_done = !has_header;
+}
+
+std::unique_ptr<SharedRecordReader> SharedRecords::reader(){
+    if(first != 0)
+        throw std::logic_error("Readers must be added before reading records");
+    cursors.push_back(0);
+    return std::unique_ptr<SharedRecordReader>(
+            new SharedRecordReader(*this, cursors.size() - 1));
+}
+
+const VcfEntry *SharedRecords::get(uint64_t record){
+    while(record >= first + buffer.size()){
+        if(input_done)
+            return nullptr;
+        if(spare.empty())
+            buffer.push_back(vcf_file.initialize_entry());
+        else{
+            buffer.push_back(std::move(spare.back()));
+            spare.pop_back();
+        }
+        if(!source->next_record(vcf_file, buffer.back())){
+            spare.push_back(std::move(buffer.back()));
+            buffer.pop_back();
+            input_done = true;
+        }
+    }
+    return &buffer[record - first];
+}
+
+void SharedRecords::trim(){
+    // drop records every reader has passed
+    uint64_t slowest = *std::min_element(cursors.begin(), cursors.end());
+    for( ; first < slowest && !buffer.empty(); ++first){
+        spare.push_back(std::move(buffer.front()));
+        buffer.pop_front();
+    }
+}
+
+bool SharedRecordReader::read_header(VcfFile &vcf_file,
+        const std::set<std::string> &individuals){
+    if(!records.has_header)
+        return false;
+    // samples of the shared individuals by their vcf column, leaving others
+    // blank so only shared individuals are selected
+    const auto &shared = records.vcf_file.individual_map;
+    std::vector<std::string> samples;
+    if(!shared.empty())
+        samples.resize(shared.rbegin()->first - 8);
+    for(const auto &individual : shared)
+        samples[individual.first - 9] = individual.second;
+    std::set<std::string> selected = individuals;
+    if(selected.empty())
+        for(const auto &individual : shared)
+            selected.insert(individual.second);
+    vcf_file.initialize_individuals(samples, selected);
+
+    columns.clear();
+    unsigned int column = 0;
+    for(const auto &individual : shared){
+        if(vcf_file.individual_map.count(individual.first))
+            columns.push_back(column);
+        ++column;
+    }
+    return true;
+}
+
+bool SharedRecordReader::next_record(VcfFile &vcf_file, VcfEntry &entry){
+    uint64_t &cursor = records.cursors[id];
+    const VcfEntry *record = records.get(cursor);
+    if(record == nullptr)
+        return false;
+
+    if(entry.chromosome != record->chromosome)
+        entry.chromosome = record->chromosome;
+    entry.position = record->position;
+    entry.reference = record->reference;
+    entry.alternative = record->alternative;
+    entry.genotypes.resize(columns.size());
+    for(size_t i = 0; i < columns.size(); ++i)
+        entry.genotypes[i] = record->genotypes[columns[i]];
+    if(vcf_file.packs_haplotypes())
+        entry.pack_haplotypes();
+
+    if(cursor++ == records.first)
+        records.trim();
+    return true;
+}
+
+void SharedRecordReader::seek(uint64_t){
+    throw std::logic_error("Shared records cannot seek");
+}
+
+uint64_t SharedRecordReader::position() const{
+    return records.cursors[id];
+}
@@ -0,0 +1,22 @@
+#include "sstar2/simd.h"
+
+SimdLevel detect_simd_level(){
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return SimdLevel::avx2;
+    if(__builtin_cpu_supports("sse4.1"))
+        return SimdLevel::sse4;
+#endif
+    return SimdLevel::scalar;
+}
+
+std::vector<SimdLevel> supported_simd_levels(){
+    std::vector<SimdLevel> levels{SimdLevel::scalar};
+    SimdLevel detected = detect_simd_level();
+    if(detected == SimdLevel::sse4 || detected == SimdLevel::avx2)
+        levels.push_back(SimdLevel::sse4);
+    if(detected == SimdLevel::avx2)
+        levels.push_back(SimdLevel::avx2);
+    return levels;
+}
@@ -1,4 +1,17 @@
 #include "sstar2/sstar.h"
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+SStarCaller::SStarCaller(const std::vector<long> &bonuses,
+        const std::vector<long> &penalties) : scratch(1){
+    for(long bonus : bonuses)
+        for(long penalty : penalties)
+            settings.push_back({bonus, penalty});
+    if(settings.empty())
+        throw std::invalid_argument("No match bonus or mismatch penalty");
+}
 
 void SStarCaller::write_header(std::ostream &output){
     output << 
@@ -11,150 +24,351 @@ void SStarCaller::write_header(std::ostream &output){
         "s_start\ts_end\t"
         "n_s_star_snps_hap1\tn_s_star_snps_hap2\t"
         "s_star_haps\t"
-        "callable_bases\n";
+        "callable_bases";
+    if(settings.size() > 1)
+        output << "\tmatch_bonus\tmismatch_penalty";
+    output << '\n';
+}
+
+void SStarCaller::set_threads(unsigned int threads){
+    if(threads > 1)
+        pool.reset(new ThreadPool(threads));
+    else
+        pool.reset();
+    scratch.resize(std::max(threads, 1u));
+}
+
+WindowSummary SStarCaller::summarize(WindowGenerator &generator) const{
+    WindowSummary summary;
+    summary.chromosome = generator.window->chromosome;
+    summary.start = generator.window->start;
+    summary.end = generator.window->end;
+    summary.total_snps = generator.window->total_snps();
+    if (summary.total_snps <= 2)
+        return summary;
+    summary.ref_snps = generator.window->reference_snps();
+    summary.callable = generator.callable_length();
+    return summary;
 }
 
 void SStarCaller::write_window(std::ostream &output,
                 WindowGenerator &generator){
-    unsigned int total_snps = generator.window->total_snps();
-    if (total_snps <=2)
+    if(!take_snapshot(generator, current))
         return;
-    unsigned int ref_snps = generator.window->reference_snps();
-    unsigned int callable = generator.callable_length();
-    for(unsigned int i = 0; i < generator.targets.size(); ++i){
-        unsigned int indiv_snps = generator.window->individual_snps(i);
-        output << generator.window->chromosome << '\t'
-            << generator.window->start << '\t'
-            << generator.window->end << '\t'
-            << total_snps << '\t'
-            << indiv_snps << '\t'
-            << indiv_snps + ref_snps << '\t'
-            << generator.target_names[i] << '\t'
-            << generator.population_names[i] << '\t';
-        if (indiv_snps <= 2)
-            output << emptyline;
-        else{
-            // build genotypes vector
-            std::vector<WindowGT> genotypes;
-            genotypes.reserve(indiv_snps);
-            generator.window->fill_genotypes(genotypes, i);
-            long s_score = sstar(genotypes);
-            output << s_score << '\t'
-                << genotypes.size() << '\t';
-
-            unsigned long hap1start=0, hap2start=0, hap1end=0, hap2end=0;
-            int hap1count = 0, hap2count = 0;
-            bool first = true;
-            for (const auto &gt : genotypes){
-                // print positions joined on a comma
-                if (first)
-                    first = !first;
-                else
-                    output << ',';
-                output << gt.position;
-
-                // update haplo start and end
-                if(gt.genotype == 1 || gt.genotype == 3){
-                    ++hap1count;
-                    hap1end = gt.position;
-                    if(hap1start == 0)
-                        hap1start = gt.position;
-                }
-                if(gt.genotype == 2 || gt.genotype == 3){
-                    ++hap2count;
-                    hap2end = gt.position;
-                    if(hap2start == 0)
-                        hap2start = gt.position;
-                }
-            }
-            // if only contains one snp, set to 0
-            if (hap1start == hap1end)
-                hap1start = hap1end = 0;
-            if (hap2start == hap2end)
-                hap2start = hap2end = 0;
-
-            output << '\t' << hap1start << '\t'
-                << hap1end << '\t'
-                << hap2start << '\t'
-                << hap2end << '\t'
-                << genotypes.front().position << '\t'  // s start
-                << genotypes.back().position << '\t'  // s end
-                << hap1count << '\t'
-                << hap2count << '\t';
-            // write comma joined haplotypes
-            first = true;
-            for (const auto &gt : genotypes){
-                if (first)
-                    first = !first;
-                else
-                    output << ',';
-                output << gt.genotype;
-            }
-            output << '\t';
+    size_t targets = current.genotypes.size();
+    find_duplicates(current);
+
+    auto score = [&](size_t i, unsigned int worker){
+        if(current.duplicate_of[i] == i)
+            score_target(current, i, scratch[worker]);
+    };
+    if(pool)
+        pool->parallel_for(targets, score);
+    else
+        for(size_t i = 0; i < targets; ++i)
+            score(i, 0);
+    write_rows(rows, current);
+    rows.flush(output);
+}
+
+bool SStarCaller::take_snapshot(WindowGenerator &generator,
+        WindowSnapshot &snapshot) const{
+    snapshot.summary = summarize(generator);
+    if (snapshot.summary.total_snps <= 2)
+        return false;
+    size_t targets = generator.targets.size();
+    snapshot.target_names = &generator.target_names;
+    snapshot.population_names = &generator.population_names;
+    snapshot.individual_snps = generator.window->individual_counts();
+    snapshot.genotypes.resize(targets);
+    for(size_t i = 0; i < targets; ++i){
+        snapshot.genotypes[i].clear();
+        if(snapshot.individual_snps[i] > 2)
+            generator.window->fill_genotypes(snapshot.genotypes[i], i);
+    }
+    return true;
+}
+
+void SStarCaller::write_snapshot(OutputBuffer &output,
+        WindowSnapshot &snapshot, TargetScratch &target_scratch) const{
+    find_duplicates(snapshot);
+    for(size_t i = 0; i < snapshot.genotypes.size(); ++i)
+        if(snapshot.duplicate_of[i] == i)
+            score_target(snapshot, i, target_scratch);
+    write_rows(output, snapshot);
+}
+
+// hash of the positions and genotypes of a target
+static uint64_t hash_genotypes(const std::vector<WindowGT> &genotypes){
+    uint64_t hash = genotypes.size();
+    for(const auto &gt : genotypes){
+        hash ^= (gt.position << 2 | gt.genotype) + 0x9e3779b97f4a7c15 +
+            (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+void SStarCaller::find_duplicates(WindowSnapshot &snapshot) const{
+    size_t targets = snapshot.genotypes.size();
+    snapshot.duplicate_of.resize(targets);
+    snapshot.fields.resize(targets);
+    std::unordered_map<uint64_t, size_t> seen;
+    uint64_t scored = 0, reused = 0;
+    for(size_t i = 0; i < targets; ++i){
+        snapshot.duplicate_of[i] = i;
+        if(snapshot.individual_snps[i] <= 2)
+            continue;
+        auto found = seen.emplace(hash_genotypes(snapshot.genotypes[i]), i);
+        size_t first = found.first->second;
+        if(!found.second && snapshot.genotypes[first] == snapshot.genotypes[i]){
+            snapshot.duplicate_of[i] = first;
+            ++reused;
         }
-        output << callable << '\n';
+        else
+            ++scored;
     }
+    scored_targets += scored;
+    reused_targets += reused;
 }
 
+void SStarCaller::score_target(WindowSnapshot &snapshot, size_t target,
+        TargetScratch &target_scratch) const{
+    std::vector<WindowGT> &genotypes = snapshot.genotypes[target];
+    std::vector<std::string> &fields = snapshot.fields[target];
+    fields.resize(settings.size());
+    if (snapshot.individual_snps[target] <= 2)
+        return;
+
+    // lay out the genotypes once for every setting
+    SStarBuffer &buffer = target_scratch.buffer;
+    buffer.resize(genotypes.size());
+    bool kernel = simd_level != SimdLevel::scalar &&
+        fits_kernel(genotypes, buffer);
+
+    // the snps of a single setting replace the genotypes
+    std::vector<WindowGT> &selected = settings.size() == 1 ?
+        genotypes : target_scratch.selected;
+    for(size_t i = 0; i < settings.size(); ++i){
+        long s_score = score(settings[i], kernel, genotypes, buffer, selected);
+        target_scratch.fields.clear();
+        write_fields(target_scratch.fields, s_score, selected);
+        fields[i].assign(target_scratch.fields.data(),
+                target_scratch.fields.size());
+    }
+}
+
+void SStarCaller::write_rows(OutputBuffer &output,
+        const WindowSnapshot &snapshot) const{
+    const WindowSummary &summary = snapshot.summary;
+    for(size_t i = 0; i < snapshot.genotypes.size(); ++i){
+        unsigned int indiv_snps = snapshot.individual_snps[i];
+        for(size_t j = 0; j < settings.size(); ++j){
+            output << summary.chromosome << '\t'
+                << summary.start << '\t'
+                << summary.end << '\t'
+                << summary.total_snps << '\t'
+                << indiv_snps << '\t'
+                << indiv_snps + summary.ref_snps << '\t'
+                << (*snapshot.target_names)[i] << '\t'
+                << (*snapshot.population_names)[i] << '\t';
+            if (indiv_snps <= 2)
+                output << emptyline;
+            else
+                output << snapshot.fields[snapshot.duplicate_of[i]][j];
+            output << summary.callable;
+            if(settings.size() > 1)
+                output << '\t' << settings[j].match_bonus << '\t'
+                    << settings[j].mismatch_penalty;
+            output << '\n';
+        }
+    }
+}
+
+void SStarCaller::write_fields(OutputBuffer &output, long s_score,
+        const std::vector<WindowGT> &genotypes) const{
+    output << s_score << '\t'
+        << genotypes.size() << '\t';
+
+    unsigned long hap1start=0, hap2start=0, hap1end=0, hap2end=0;
+    int hap1count = 0, hap2count = 0;
+    bool first = true;
+    for (const auto &gt : genotypes){
+        // print positions joined on a comma
+        if (first)
+            first = !first;
+        else
+            output << ',';
+        output << gt.position;
+
+        // update haplo start and end
+        if(gt.genotype == 1 || gt.genotype == 3){
+            ++hap1count;
+            hap1end = gt.position;
+            if(hap1start == 0)
+                hap1start = gt.position;
+        }
+        if(gt.genotype == 2 || gt.genotype == 3){
+            ++hap2count;
+            hap2end = gt.position;
+            if(hap2start == 0)
+                hap2start = gt.position;
+        }
+    }
+    // if only contains one snp, set to 0
+    if (hap1start == hap1end)
+        hap1start = hap1end = 0;
+    if (hap2start == hap2end)
+        hap2start = hap2end = 0;
+
+    output << '\t' << hap1start << '\t'
+        << hap1end << '\t'
+        << hap2start << '\t'
+        << hap2end << '\t';
+    // no sstar snps when every pair of snps is under 10 bp apart
+    if (genotypes.empty())
+        output << "0\t0\t";
+    else
+        output << genotypes.front().position << '\t'  // s start
+            << genotypes.back().position << '\t';  // s end
+    output << hap1count << '\t'
+        << hap2count << '\t';
+    // write comma joined haplotypes
+    first = true;
+    for (const auto &gt : genotypes){
+        if (first)
+            first = !first;
+        else
+            output << ',';
+        output << gt.genotype;
+    }
+    output << '\t';
+}
+
+// marks a snp which has not been used to build a score
+static const long unset_snp = -1;
+
 long SStarCaller::sstar(std::vector<WindowGT> &genotypes){
+    SStarBuffer buffer;
+    return sstar(genotypes, buffer);
+}
+
+long SStarCaller::sstar(std::vector<WindowGT> &genotypes,
+        SStarBuffer &buffer) const{
+    buffer.resize(genotypes.size());
+    bool kernel = simd_level != SimdLevel::scalar &&
+        fits_kernel(genotypes, buffer);
+    return score(settings.front(), kernel, genotypes, buffer, genotypes);
+}
+
+long SStarCaller::score(const SStarSetting &setting, bool kernel,
+        const std::vector<WindowGT> &genotypes, SStarBuffer &buffer,
+        std::vector<WindowGT> &selected) const{
     size_t nsnps = genotypes.size();
-    // start with 10 mismatches as no-score without worring about overflow
-    std::vector<int> scores(nsnps, mismatch_penalty*10);
-    long new_score, append_score, bp_dist;
-    // using snps as a 2d vector below
-    std::vector<uint8_t> snps(nsnps*nsnps, false);  // true if snps is used
-    short int gt;
     for (size_t k = 0; k < nsnps; ++k){
-        for (size_t j = 0; j < k; ++j){
-            bp_dist = genotypes[k].position - genotypes[j].position;
-            if(bp_dist < 10)
-                continue;
-
-            // see NOTE XOR below
-            gt = genotypes[k].genotype ^ genotypes[j].genotype;
-            new_score = ((gt == 0) | (gt == 3))?
-                match_bonus + bp_dist :
-                mismatch_penalty;
-
-            append_score = scores[j] + new_score;
-
-            if (scores[k] < append_score){
-                scores[k] = append_score;
-                std::copy(snps.begin() + j*nsnps,
-                        snps.begin() + (j+1)*nsnps,
-                        snps.begin() + k*nsnps);
-                snps[k*nsnps + k] = true;
-            }
-            if (scores[k] < new_score){
-                scores[k] = new_score;
-                std::fill(snps.begin() + k*nsnps,
-                        snps.begin() + (k+1) * nsnps,
-                        false);
-                snps[k*nsnps + j] = true;
-                snps[k*nsnps + k] = true;
-            }
-        }
+        // start with 10 mismatches as no-score without worring about overflow
+        buffer.scores[k] = setting.mismatch_penalty*10;
+        // the snps used for a score are stored as a linked list through
+        // predecessors.  see NOTE TRACEBACK below
+        buffer.previous[k] = unset_snp;
+        buffer.chain_start[k] = false;
+        if(kernel)
+            score_kernel(setting, buffer, k);
+        else
+            score_scalar(setting, genotypes, buffer, k);
     }
-    auto maxScore = std::max_element(scores.begin(), scores.end());
 
-    // update genotypes based on maxScore
+    auto maxScore = std::max_element(buffer.scores.begin(), buffer.scores.end());
+
+    // update genotypes based on maxScore, walking back from the max
     std::vector<WindowGT> gts;
     gts.reserve(nsnps);
-    auto gt_input = genotypes.begin();
-    // copy over snps which are used in max score
-    auto maxIndex = maxScore - scores.begin();
-    auto maxSnp = snps.begin() + maxIndex * nsnps;
-    for(int i = 0; i < nsnps; ++i){
-        if(*maxSnp)
-            gts.push_back(*gt_input);
-        ++gt_input;
-        ++maxSnp;
+    long snp = maxScore - buffer.scores.begin();
+    while(snp != unset_snp && buffer.previous[snp] != unset_snp){
+        gts.push_back(genotypes[snp]);
+        if(buffer.chain_start[snp]){
+            gts.push_back(genotypes[buffer.previous[snp]]);
+            break;
+        }
+        snp = buffer.previous[snp];
     }
 
-    genotypes.assign(gts.begin(), gts.end());
+    selected.assign(gts.rbegin(), gts.rend());
     return *maxScore;
 }
 
+bool SStarCaller::fits_kernel(const std::vector<WindowGT> &genotypes,
+        SStarBuffer &buffer) const{
+    // the kernels work on 32 bit positions and scores.  Fills buffer with
+    // relative positions and returns false if any score of any setting
+    // could overflow
+    if(genotypes.empty())
+        return true;
+    unsigned long largest_score = 0;
+    for(const auto &setting : settings)
+        largest_score = std::max<unsigned long>(largest_score,
+                std::abs(setting.match_bonus) + std::abs(setting.mismatch_penalty));
+    unsigned long first = genotypes.front().position,
+                  lowest = first, highest = first;
+    for(const auto &gt : genotypes){
+        lowest = std::min(lowest, gt.position);
+        highest = std::max(highest, gt.position);
+    }
+    unsigned long limit = std::numeric_limits<int32_t>::max() / 2;
+    unsigned long largest = highest - lowest + largest_score;
+    if(largest > limit || largest * (genotypes.size() + 11) > limit)
+        return false;
+
+    for(size_t i = 0; i < genotypes.size(); ++i){
+        buffer.positions[i] = (long)(genotypes[i].position - first);
+        buffer.genotypes[i] = genotypes[i].genotype;
+    }
+    return true;
+}
+
+void SStarCaller::score_kernel(const SStarSetting &setting,
+        SStarBuffer &buffer, size_t k) const{
+    // vectorized version of score_scalar with identical tie breaking
+    Predecessor best = best_predecessor(simd_level, buffer, k,
+            setting.match_bonus, setting.mismatch_penalty);
+    if(best.index != unset_snp && buffer.scores[k] < best.score){
+        buffer.scores[k] = best.score;
+        buffer.previous[k] = best.index;
+        buffer.chain_start[k] = best.chain_start;
+    }
+}
+
+void SStarCaller::score_scalar(const SStarSetting &setting,
+        const std::vector<WindowGT> &genotypes, SStarBuffer &buffer,
+        size_t k) const{
+    long new_score, append_score, bp_dist;
+    short int gt;
+    std::vector<int32_t> &scores = buffer.scores;
+    for (size_t j = 0; j < k; ++j){
+        bp_dist = genotypes[k].position - genotypes[j].position;
+        if(bp_dist < 10)
+            continue;
+
+        // see NOTE XOR below
+        gt = genotypes[k].genotype ^ genotypes[j].genotype;
+        new_score = ((gt == 0) | (gt == 3))?
+            setting.match_bonus + bp_dist :
+            setting.mismatch_penalty;
+
+        append_score = scores[j] + new_score;
+
+        if (scores[k] < append_score){
+            scores[k] = append_score;
+            buffer.previous[k] = j;
+            buffer.chain_start[k] = false;
+        }
+        if (scores[k] < new_score){
+            scores[k] = new_score;
+            buffer.previous[k] = j;
+            buffer.chain_start[k] = true;
+        }
+    }
+}
+
 // NOTE XOR
 // valid genotypes are 1, 2, 3 at this point
 // bitwise xor maps as follows:
@@ -167,3 +381,11 @@ long SStarCaller::sstar(std::vector<WindowGT> &genotypes){
 // 3  3  0
 // at this point gt is equal to 0 if j, k match or 3 if 
 // j/k = 1/2
+
+// NOTE TRACEBACK
+// each snp k records the snp it extended, previous[k], when its score was
+// last improved.  If chain_start[k] is set, the score came from the pair
+// (previous[k], k) alone, otherwise it is the set of previous[k] plus k.
+// A snp which was never updated has an empty set, so extending it yields
+// only k itself.  Walking back from the max score recovers the snps in
+// reverse order.
@@ -0,0 +1,170 @@
+#include "sstar2/sstar_kernel.h"
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SSTAR_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+void SStarBuffer::resize(size_t nsnps){
+    positions.resize(nsnps);
+    genotypes.resize(nsnps);
+    scores.resize(nsnps);
+    previous.resize(nsnps);
+    chain_start.resize(nsnps);
+}
+
+// score of pairing snp j with k, see NOTE XOR in sstar.cc
+static inline int32_t pair_score(const SStarBuffer &buffer, size_t j, size_t k,
+        int32_t match_bonus, int32_t mismatch_penalty){
+    int32_t gt = buffer.genotypes[k] ^ buffer.genotypes[j];
+    return ((gt == 0) | (gt == 3)) ?
+        match_bonus + buffer.positions[k] - buffer.positions[j] :
+        mismatch_penalty;
+}
+
+// continue the search over [begin, k), only replacing on strictly larger
+static void scan_scalar(const SStarBuffer &buffer, size_t begin, size_t k,
+        int32_t match_bonus, int32_t mismatch_penalty, Predecessor &best){
+    for(size_t j = begin; j < k; ++j){
+        if(buffer.positions[k] - buffer.positions[j] < 10)
+            continue;
+        int32_t new_score = pair_score(buffer, j, k, match_bonus, mismatch_penalty);
+        int32_t candidate = std::max(buffer.scores[j] + new_score, new_score);
+        if(best.index < 0 || best.score < candidate){
+            best.index = j;
+            best.score = candidate;
+        }
+    }
+}
+
+#ifdef SSTAR_X86_KERNELS
+
+// merge per-lane maxima, ties go to the smallest index
+static void reduce_lanes(const int32_t *scores, const int32_t *indices,
+        int lanes, Predecessor &best){
+    for(int i = 0; i < lanes; ++i){
+        if(indices[i] < 0)
+            continue;
+        if(best.index < 0 || best.score < scores[i] ||
+                (best.score == scores[i] && indices[i] < best.index)){
+            best.index = indices[i];
+            best.score = scores[i];
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const SStarBuffer &buffer, size_t k,
+        int32_t match_bonus, int32_t mismatch_penalty, Predecessor &best){
+    const int32_t *positions = buffer.positions.data();
+    const int32_t *genotypes = buffer.genotypes.data();
+    const int32_t *scores = buffer.scores.data();
+    const __m256i pos_k = _mm256_set1_epi32(positions[k]);
+    const __m256i gt_k = _mm256_set1_epi32(genotypes[k]);
+    const __m256i nine = _mm256_set1_epi32(9);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bonus = _mm256_set1_epi32(match_bonus);
+    const __m256i penalty = _mm256_set1_epi32(mismatch_penalty);
+    const __m256i step = _mm256_set1_epi32(8);
+    __m256i lane_best = _mm256_set1_epi32(std::numeric_limits<int32_t>::min());
+    __m256i lane_index = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    size_t j = 0;
+    for(; j + 8 <= k; j += 8){
+        __m256i dist = _mm256_sub_epi32(pos_k,
+                _mm256_loadu_si256((const __m256i*)(positions + j)));
+        __m256i valid = _mm256_cmpgt_epi32(dist, nine);
+        __m256i gt = _mm256_xor_si256(gt_k,
+                _mm256_loadu_si256((const __m256i*)(genotypes + j)));
+        __m256i match = _mm256_or_si256(_mm256_cmpeq_epi32(gt, zero),
+                _mm256_cmpeq_epi32(gt, three));
+        __m256i new_score = _mm256_blendv_epi8(penalty,
+                _mm256_add_epi32(bonus, dist), match);
+        __m256i append_score = _mm256_add_epi32(new_score,
+                _mm256_loadu_si256((const __m256i*)(scores + j)));
+        __m256i candidate = _mm256_max_epi32(append_score, new_score);
+        __m256i update = _mm256_and_si256(valid,
+                _mm256_cmpgt_epi32(candidate, lane_best));
+        lane_best = _mm256_blendv_epi8(lane_best, candidate, update);
+        lane_index = _mm256_blendv_epi8(lane_index, index, update);
+        index = _mm256_add_epi32(index, step);
+    }
+
+    int32_t lane_scores[8], lane_indices[8];
+    _mm256_storeu_si256((__m256i*)lane_scores, lane_best);
+    _mm256_storeu_si256((__m256i*)lane_indices, lane_index);
+    reduce_lanes(lane_scores, lane_indices, 8, best);
+    return j;
+}
+
+__attribute__((target("sse4.1")))
+static size_t scan_sse4(const SStarBuffer &buffer, size_t k,
+        int32_t match_bonus, int32_t mismatch_penalty, Predecessor &best){
+    const int32_t *positions = buffer.positions.data();
+    const int32_t *genotypes = buffer.genotypes.data();
+    const int32_t *scores = buffer.scores.data();
+    const __m128i pos_k = _mm_set1_epi32(positions[k]);
+    const __m128i gt_k = _mm_set1_epi32(genotypes[k]);
+    const __m128i nine = _mm_set1_epi32(9);
+    const __m128i three = _mm_set1_epi32(3);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bonus = _mm_set1_epi32(match_bonus);
+    const __m128i penalty = _mm_set1_epi32(mismatch_penalty);
+    const __m128i step = _mm_set1_epi32(4);
+    __m128i lane_best = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+    __m128i lane_index = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+
+    size_t j = 0;
+    for(; j + 4 <= k; j += 4){
+        __m128i dist = _mm_sub_epi32(pos_k,
+                _mm_loadu_si128((const __m128i*)(positions + j)));
+        __m128i valid = _mm_cmpgt_epi32(dist, nine);
+        __m128i gt = _mm_xor_si128(gt_k,
+                _mm_loadu_si128((const __m128i*)(genotypes + j)));
+        __m128i match = _mm_or_si128(_mm_cmpeq_epi32(gt, zero),
+                _mm_cmpeq_epi32(gt, three));
+        __m128i new_score = _mm_blendv_epi8(penalty,
+                _mm_add_epi32(bonus, dist), match);
+        __m128i append_score = _mm_add_epi32(new_score,
+                _mm_loadu_si128((const __m128i*)(scores + j)));
+        __m128i candidate = _mm_max_epi32(append_score, new_score);
+        __m128i update = _mm_and_si128(valid,
+                _mm_cmpgt_epi32(candidate, lane_best));
+        lane_best = _mm_blendv_epi8(lane_best, candidate, update);
+        lane_index = _mm_blendv_epi8(lane_index, index, update);
+        index = _mm_add_epi32(index, step);
+    }
+
+    int32_t lane_scores[4], lane_indices[4];
+    _mm_storeu_si128((__m128i*)lane_scores, lane_best);
+    _mm_storeu_si128((__m128i*)lane_indices, lane_index);
+    reduce_lanes(lane_scores, lane_indices, 4, best);
+    return j;
+}
+
+#endif
+
+Predecessor best_predecessor(SimdLevel level, const SStarBuffer &buffer,
+        size_t k, int32_t match_bonus, int32_t mismatch_penalty){
+    Predecessor best{-1, 0, false};
+    size_t begin = 0;
+#ifdef SSTAR_X86_KERNELS
+    if(level == SimdLevel::avx2)
+        begin = scan_avx2(buffer, k, match_bonus, mismatch_penalty, best);
+    else if(level == SimdLevel::sse4)
+        begin = scan_sse4(buffer, k, match_bonus, mismatch_penalty, best);
+#endif
+    scan_scalar(buffer, begin, k, match_bonus, mismatch_penalty, best);
+
+    if(best.index >= 0){
+        // a new chain only wins when strictly better than extending
+        int32_t new_score = pair_score(buffer, best.index, k,
+                match_bonus, mismatch_penalty);
+        best.chain_start = new_score > buffer.scores[best.index] + new_score;
+    }
+    return best;
+}
@@ -0,0 +1,63 @@
+#include "sstar2/thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned int threads){
+    for(unsigned int i = 1; i < threads; ++i)
+        workers.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_work.notify_all();
+    for(auto &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::run_tasks(unsigned int worker){
+    // take tasks until none are left
+    for(size_t index = next_task++; index < task_count; index = next_task++)
+        (*task)(index, worker);
+}
+
+void ThreadPool::work(unsigned int worker){
+    unsigned long seen = 0;
+    for(;;){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_work.wait(lock, [&]{ return stopping || generation != seen; });
+            if(stopping)
+                return;
+            seen = generation;
+        }
+        run_tasks(worker);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --running;
+        }
+        finished_work.notify_one();
+    }
+}
+
+void ThreadPool::parallel_for(size_t count,
+        const std::function<void(size_t, unsigned int)> &task){
+    if(workers.empty()){
+        for(size_t i = 0; i < count; ++i)
+            task(i, 0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        task_count = count;
+        next_task = 0;
+        running = workers.size();
+        ++generation;
+    }
+    start_work.notify_all();
+    run_tasks(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    finished_work.wait(lock, [&]{ return running == 0; });
+    this->task = nullptr;
+}
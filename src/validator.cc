@@ -1,160 +1,198 @@
 #include "sstar2/validator.h"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace chromosome_ids {
+static std::mutex mutex;
+static std::unordered_map<std::string, unsigned int> ids;
+static std::deque<std::string> names;  // references stay valid on growth
+
+unsigned int id(const std::string &chromosome) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto inserted = ids.emplace(chromosome, names.size());
+  if (inserted.second) names.push_back(chromosome);
+  return inserted.first->second;
+}
+
+const std::string &name(unsigned int id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return names[id];
+}
+}  // namespace chromosome_ids
+
+unsigned int BaseRegions::chromosome_id(const std::string &chrom) {
+  if (chrom != last_name || last_name.empty()) {
+    last_id = chromosome_ids::id(chrom);
+    last_name = chrom;
+  }
+  return last_id;
+}
+
+const std::vector<Interval> *BaseRegions::find(unsigned int id) const {
+  if (id >= present.size() || !present[id]) return nullptr;
+  return &intervals[id];
+}
 
 void BaseRegions::add(const std::string &chrom, unsigned long start,
                       unsigned long end) {
   // add region.  assumes sorted input with no overlap
-  if (positions.count(chrom) == 0)
-    positions.insert(
-        std::pair<std::string, std::list<unsigned long>>(chrom, {start, end}));
-  else {
-    positions[chrom].push_back(start);
-    positions[chrom].push_back(end);
+  unsigned int id = chromosome_id(chrom);
+  if (id >= intervals.size()) {
+    intervals.resize(id + 1);
+    present.resize(id + 1);
+  }
+  if (!present[id]) {
+    present[id] = true;
+    chromosomes.push_back(id);
+  }
+  intervals[id].push_back({start, end});
+}
+
+void BaseRegions::clear() {
+  // keeps storage
+  for (auto id : chromosomes) {
+    intervals[id].clear();
+    present[id] = false;
   }
+  chromosomes.clear();
 }
 
 void BaseRegions::set(const std::string &chrom, unsigned long start,
                       unsigned long end) {
   // set region to chromosome with a single entry
-  positions.clear();
+  clear();
   add(chrom, start, end);
 }
 
 unsigned long BaseRegions::totalLength() {
   // get total callable bases
-  if (positions.empty()) return 0;
   unsigned long result = 0;
-  // this keeps start and end in step
-  for (auto &pair : positions) {
-    for (auto start = pair.second.begin(), end = std::next(start);
-         start != pair.second.end();
-         std::advance(start, 2), std::advance(end, 2))
-      result += *end - *start;
-  }
+  for (auto id : chromosomes)
+    for (const auto &interval : intervals[id])
+      result += interval.end - interval.start;
   return result;
 }
 
 void BaseRegions::intersect(const BaseRegions &other) {
   // assume both are strictly increasing with no overlap within segments
-  for (auto &pos : positions) {
-    auto otherpos = other.positions.find(pos.first);
-    // not in other or is empty
-    if (otherpos == other.positions.end() || otherpos->second.empty()) {
-      pos.second.clear();
-      return;
-    }
-    auto mystart = pos.second.begin(), myend = std::next(mystart);
-    auto otherstart = otherpos->second.begin(),
-         otherend = std::next(otherstart);
-    while (mystart != pos.second.end() &&
-           otherstart != otherpos->second.end()) {
-      if (*mystart >= *otherend) {  // other too far behind
-        std::advance(otherstart, 2);
-        std::advance(otherend, 2);
-        continue;
-      }
-      if (*otherstart >= *myend) {  // mine too far behind
-        // remove this as it doesn't match
-        mystart = pos.second.erase(mystart, std::next(myend));
-        myend = std::next(mystart);
-        continue;
-      }
-      // now we have some overlap
-      if (*otherstart > *mystart)  // start must be cut
-        *mystart = *otherstart;
-      // end can be used again...
-      if (*otherend < *myend) {
-        // set this end to otherend, new start there as well
-        pos.second.insert(myend, 2, *otherend);
-        std::advance(mystart, 2);
-        std::advance(otherstart, 2);
-        std::advance(otherend, 2);
-      } else {  // otherend > mine, go to next
-        std::advance(mystart, 2);
-        std::advance(myend, 2);
+  for (auto id : chromosomes) {
+    auto &mine = intervals[id];
+    auto theirs = other.find(id);
+    buffer.clear();
+    if (theirs != nullptr) {
+      auto my = mine.begin();
+      auto their = theirs->begin();
+      while (my != mine.end() && their != theirs->end()) {
+        if (my->start < their->end && their->start < my->end)
+          buffer.push_back({std::max(my->start, their->start),
+                            std::min(my->end, their->end)});
+        // the interval ending last can overlap the next one
+        if (their->end < my->end)
+          ++their;
+        else
+          ++my;
       }
     }
-    if (mystart != pos.second.end())  // remove any remaining
-      pos.second.erase(mystart, pos.second.end());
+    mine.swap(buffer);
   }
 }
 
 void BaseRegions::subtract(const BaseRegions &other) {
   // assume both are strictly increasing with no overlap within segments
-  for (auto &pos : positions) {
-    auto otherpos = other.positions.find(pos.first);
-    // not in other or is empty
+  for (auto id : chromosomes) {
+    auto theirs = other.find(id);
     // nothing to subtract
-    if (otherpos == other.positions.end() || otherpos->second.empty()) continue;
-
-    auto mystart = pos.second.begin(), myend = std::next(mystart);
-    auto otherstart = otherpos->second.begin(),
-         otherend = std::next(otherstart);
-    while (mystart != pos.second.end() &&
-           otherstart != otherpos->second.end()) {
-      if (*mystart >= *otherend) {  // other too far behind
-        std::advance(otherstart, 2);
-        std::advance(otherend, 2);
-        continue;
-      }
-      if (*otherstart >= *myend) {  // mine too far behind
-        std::advance(mystart, 2);
-        std::advance(myend, 2);
-        continue;
-      }
-      // now we have some overlap
-      if (*otherstart > *mystart) {  // start after mine
-        // keep first part
-        pos.second.insert(myend, 2, *otherstart);
-        std::advance(mystart, 2);
-      }
+    if (theirs == nullptr || theirs->empty()) continue;
 
-      if (*otherend < *myend) {  // other end in region
-        // move end
-        *mystart = *otherend;
-        // advance other, mine can be used
-        std::advance(otherstart, 2);
-        std::advance(otherend, 2);
-      } else {  // end beyond, remove this consider other again
-        mystart = pos.second.erase(mystart, std::next(myend));
-        myend = std::next(mystart);
+    auto &mine = intervals[id];
+    buffer.clear();
+    auto their = theirs->begin();
+    for (auto my = mine.begin(); my != mine.end(); ++my) {
+      unsigned long start = my->start;
+      bool removed = false;
+      for (; their != theirs->end(); ++their) {
+        if (their->end <= start) continue;  // other too far behind
+        if (their->start >= my->end) break;  // mine too far behind
+        // now we have some overlap, keep the part before it
+        if (their->start > start) buffer.push_back({start, their->start});
+        if (their->end < my->end) {
+          start = their->end;
+        } else {  // covers the rest, consider other again for the next
+          removed = true;
+          break;
+        }
       }
+      if (!removed) buffer.push_back({start, my->end});
     }
+    mine.swap(buffer);
   }
 }
 
 const std::string BaseRegions::getChromosome() const {
-  return positions.begin()->first;
+  return chromosome_ids::name(chromosomes.front());
 }
 
 unsigned long BaseRegions::getEnd(const std::string &chromosome) {
-  if (positions.count(chromosome) == 0 || positions[chromosome].empty())
-    return 0;
-  return positions[chromosome].back();
+  auto regions = find(chromosome_id(chromosome));
+  if (regions == nullptr || regions->empty()) return 0;
+  return regions->back().end;
+}
+
+const std::vector<Interval> &BaseRegions::getIntervals(
+    const std::string &chromosome) {
+  static const std::vector<Interval> empty;
+  auto regions = find(chromosome_id(chromosome));
+  return regions == nullptr ? empty : *regions;
+}
+
+bool BaseRegions::getStart(const std::string &chromosome,
+                           unsigned long &start) {
+  auto regions = find(chromosome_id(chromosome));
+  if (regions == nullptr || regions->empty()) return false;
+  start = regions->front().start;
+  return true;
+}
+
+void BaseRegions::discardBefore(const std::string &chromosome,
+                                unsigned long position) {
+  unsigned int id = chromosome_id(chromosome);
+  if (find(id) == nullptr) return;
+  auto &regions = intervals[id];
+  auto keep = std::find_if(regions.begin(), regions.end(),
+                           [position](const Interval &interval) {
+                             return interval.end > position;
+                           });
+  regions.erase(regions.begin(), keep);
 }
 
 bool BaseRegions::inRegion(const std::string &chromosome,
                            unsigned long position) {
-  if (positions.count(chromosome) == 0) return false;
-  // search through positions for one in (start, end]
-  for (auto end = positions[chromosome].rbegin(), start = std::next(end);
-       end != positions[chromosome].rend();
-       std::advance(start, 2), std::advance(end, 2)) {
-    if (*start < position && position <= *end)
-      return true;
-    else if (position > *end)
-      return false;
-  }
-
-  return false;
+  auto regions = find(chromosome_id(chromosome));
+  if (regions == nullptr) return false;
+  // first interval ending at or after position, check it is in (start, end]
+  auto interval = std::lower_bound(
+      regions->begin(), regions->end(), position,
+      [](const Interval &interval, unsigned long position) {
+        return interval.end < position;
+      });
+  return interval != regions->end() && interval->start < position;
 }
 
 void BaseRegions::write(std::ostream &strm) const {
-  if (positions.empty()) {
+  if (chromosomes.empty()) {
     strm << "No region\n";
   } else {
-    for (auto &position : positions) {
-      strm << position.first << ':';
-      for (auto &pos : position.second) strm << pos << ',';
+    // chromosomes in name order
+    std::vector<std::pair<std::string, unsigned int>> names;
+    for (auto id : chromosomes) names.emplace_back(chromosome_ids::name(id), id);
+    std::sort(names.begin(), names.end());
+    for (auto &name : names) {
+      strm << name.first << ':';
+      for (auto &interval : intervals[name.second])
+        strm << interval.start << ',' << interval.end << ',';
       strm << '\n';
     }
   }
@@ -166,8 +204,20 @@ std::ostream &operator<<(std::ostream &strm, const BaseRegions region) {
 }
 
 bool FixationValidator::isValid(const VcfEntry &entry) {
-  unsigned int targ_haps = entry.count_haplotypes(targets);
-  unsigned int ref_haps = entry.count_haplotypes(references);
+  unsigned int ref_haps;
+  return isSegregating(entry, ref_haps);
+}
+
+bool FixationValidator::isSegregating(const VcfEntry &entry,
+                                      unsigned int &ref_haps) const {
+  unsigned int targ_haps;
+  if (entry.is_packed()) {
+    targ_haps = entry.count_haplotypes(target_mask);
+    ref_haps = entry.count_haplotypes(reference_mask);
+  } else {
+    targ_haps = entry.count_haplotypes(targets);
+    ref_haps = entry.count_haplotypes(references);
+  }
   if (targ_haps == 0 && ref_haps == 0)  // not found
     return false;
   if (targ_haps == targets.size() * 2 &&
@@ -207,6 +257,18 @@ void BedFile::readline() {
     chromosome = "";
 }
 
+void BedFile::advance(BaseRegions &callable) {
+  auto chrom = callable.getChromosome();
+  // need to check if end is in bedfile to force it to read through end
+  inBed(chrom, callable.getEnd(chrom));
+  // windows and records only move forward, and callable bases before the
+  // first callable start were removed by beds which are applied again to
+  // later windows, so nothing ending at or before it is queried again.
+  // Passed chromosomes keep only the intervals of their last window
+  unsigned long start;
+  if (callable.getStart(chrom, start)) regions.discardBefore(chrom, start);
+}
+
 void BedFile::intersect(BaseRegions &callable) { callable.intersect(regions); }
 
 void BedFile::subtract(BaseRegions &callable) { callable.subtract(regions); }
@@ -216,9 +278,7 @@ bool PositiveBedValidator::isValid(const VcfEntry &entry) {
 }
 
 void PositiveBedValidator::updateCallable(BaseRegions &callable) {
-  // need to check if end is in bedfile to force it to read through end
-  auto chrom = callable.getChromosome();
-  bedfile.inBed(chrom, callable.getEnd(chrom));
+  bedfile.advance(callable);
   bedfile.intersect(callable);
 }
 
@@ -227,8 +287,118 @@ bool NegativeBedValidator::isValid(const VcfEntry &entry) {
 }
 
 void NegativeBedValidator::updateCallable(BaseRegions &callable) {
-  // need to check if end is in bedfile to force it to read through end
-  auto chrom = callable.getChromosome();
-  bedfile.inBed(chrom, callable.getEnd(chrom));
+  bedfile.advance(callable);
   bedfile.subtract(callable);
 }
+
+void CallableIndex::reset(const std::string &chrom, unsigned long start) {
+  chromosome = chrom;
+  begin = computed = start;
+  intervals.clear();
+  covered.assign(1, 0);
+  cursor = 0;
+}
+
+unsigned long CallableIndex::count(unsigned long position) const {
+  // intervals before the first ending at or after position are all counted
+  auto interval = std::lower_bound(
+      intervals.begin(), intervals.end(), position,
+      [](const Interval &interval, unsigned long position) {
+        return interval.end < position;
+      });
+  size_t i = interval - intervals.begin();
+  unsigned long result = covered[i];
+  if (interval != intervals.end() && interval->start < position)
+    result += position - interval->start;
+  return result;
+}
+
+void CallableIndex::extend(
+    unsigned long end, std::vector<std::unique_ptr<Validator>> &validators) {
+  if (end <= computed) return;
+  chunk.set(chromosome, computed, end);
+  for (auto const &validator : validators) validator->updateCallable(chunk);
+  for (const auto &interval : chunk.getIntervals(chromosome)) {
+    intervals.push_back(interval);
+    covered.push_back(covered.back() + interval.end - interval.start);
+  }
+  computed = end;
+}
+
+void CallableIndex::evict(unsigned long start) {
+  auto passed = std::lower_bound(
+                    intervals.begin(), intervals.end(), start,
+                    [](const Interval &interval, unsigned long position) {
+                      return interval.end <= position;
+                    }) - intervals.begin();
+  if (passed > 0 && (size_t)passed * 2 >= intervals.size()) {
+    intervals.erase(intervals.begin(), intervals.begin() + passed);
+    covered.erase(covered.begin(), covered.begin() + passed);
+    cursor = cursor > (size_t)passed ? cursor - passed : 0;
+    begin = start;
+  }
+}
+
+unsigned long CallableIndex::length(
+    const std::string &chrom, unsigned long start, unsigned long end,
+    std::vector<std::unique_ptr<Validator>> &validators) {
+  if (end <= start) return 0;
+  // the validators have discarded the bed intervals before begin
+  if (chrom == chromosome && start < begin)
+    throw std::logic_error("Callable windows can not move backwards");
+  // new chromosome or skipped ahead
+  if (chrom != chromosome || start > computed) reset(chrom, start);
+  extend(end, validators);
+  evict(start);
+  return count(end) - count(start);
+}
+
+bool CallableIndex::contains(
+    const std::string &chrom, unsigned long position,
+    std::vector<std::unique_ptr<Validator>> &validators) {
+  // read ahead so most records are found without calling the validators
+  static const unsigned long lookahead = 1 << 16;
+  if (position == 0) return false;
+  if (chrom != chromosome || position <= begin) reset(chrom, 0);
+  if (position > computed) extend(position + lookahead, validators);
+  // positions move forward, so the cursor is usually at or just before
+  // the interval containing position
+  if (cursor > intervals.size() ||
+      (cursor > 0 && intervals[cursor - 1].end >= position))
+    cursor = 0;
+  while (cursor < intervals.size() && intervals[cursor].end < position)
+    ++cursor;
+  return cursor < intervals.size() && intervals[cursor].start < position;
+}
+
+void CallableIndex::restrict(
+    BaseRegions &callable,
+    std::vector<std::unique_ptr<Validator>> &validators) {
+  auto chrom = callable.getChromosome();
+  unsigned long start;
+  if (!callable.getStart(chrom, start)) return;
+  unsigned long end = callable.getEnd(chrom);
+  if (chrom != chromosome || start < begin) reset(chrom, 0);
+  extend(end, validators);
+  evict(start);
+
+  // intervals overlapping callable, nothing is callable without any
+  auto interval = std::lower_bound(
+      intervals.begin(), intervals.end(), start,
+      [](const Interval &interval, unsigned long position) {
+        return interval.end <= position;
+      });
+  mask.clear();
+  for (; interval != intervals.end() && interval->start < end; ++interval)
+    mask.add(chrom, std::max(interval->start, start),
+             std::min(interval->end, end));
+  callable.intersect(mask);
+}
+
+bool MaskValidator::isValid(const VcfEntry &entry) {
+  return index.contains(entry.chromosome, entry.position, validators);
+}
+
+void MaskValidator::updateCallable(BaseRegions &callable) {
+  index.restrict(callable, validators);
+}
@@ -1,5 +1,7 @@
 #include "sstar2/vcf_file.h"
+#include "sstar2/genotype_kernel.h"
 #include <sstream>
+#include <algorithm>
 
 std::string VcfEntry::to_str(void) const{
     std::ostringstream sstr;
@@ -30,43 +32,134 @@ unsigned int VcfEntry::count_haplotypes(const std::vector<unsigned int> &individ
     return result;
 }
 
+HaplotypeMask::HaplotypeMask(const std::vector<unsigned int> &individuals){
+    for (const auto &indiv : individuals){
+        if (indiv / 64 >= words.size())
+            words.resize(indiv / 64 + 1);
+        words[indiv / 64] |= (uint64_t)1 << (indiv % 64);
+    }
+}
+
+void VcfEntry::pack_haplotypes(){
+    size_t nwords = (genotypes.size() + 63) / 64;
+    first_haplotype.resize(nwords);
+    second_haplotype.resize(nwords);
+    for (size_t word = 0; word < nwords; ++word){
+        const uint8_t *gts = genotypes.data() + word * 64;
+        size_t count = std::min<size_t>(64, genotypes.size() - word * 64);
+        uint64_t first = 0, second = 0;
+        for (size_t i = 0; i < count; ++i){
+            first |= (uint64_t)(gts[i] & 1) << i;
+            second |= (uint64_t)(gts[i] >> 1) << i;
+        }
+        first_haplotype[word] = first;
+        second_haplotype[word] = second;
+    }
+}
+
+bool VcfEntry::any_haplotype(const HaplotypeMask &individuals) const{
+    size_t nwords = std::min(individuals.words.size(), first_haplotype.size());
+    uint64_t found = 0;
+    for (size_t i = 0; i < nwords; ++i)
+        found |= (first_haplotype[i] | second_haplotype[i]) & individuals.words[i];
+    return found != 0;
+}
+
+unsigned int VcfEntry::count_haplotypes(const HaplotypeMask &individuals) const{
+    size_t nwords = std::min(individuals.words.size(), first_haplotype.size());
+    unsigned int result = 0;
+    for (size_t i = 0; i < nwords; ++i)
+        result += __builtin_popcountll(first_haplotype[i] & individuals.words[i])
+            + __builtin_popcountll(second_haplotype[i] & individuals.words[i]);
+    return result;
+}
+
 unsigned int VcfFile::initialize_individuals(const std::string &line,
         const std::set<std::string> &individuals){
     // matches individuals to the location in the vcf file
     // line is the header line of vcf with individual names
     std::stringstream stream(line);
     std::string token;
+    std::vector<std::string> samples;
     unsigned int index = 0;
     while( std::getline(stream, token, '\t') ){
-        if(index > 8 &&
-                (individuals.empty() ||
-                 individuals.find(token) != individuals.end())){
-            individual_map.insert(std::pair<unsigned int, std::string>(index, token));
+        if(index > 8)
+            samples.push_back(token);
+        ++index;
+    }
+    return initialize_individuals(samples, individuals);
+}
+
+unsigned int VcfFile::initialize_individuals(
+        const std::vector<std::string> &samples,
+        const std::set<std::string> &individuals){
+    unsigned int index = 9;  // columns before the first sample
+    for (const auto &sample : samples){
+        if(individuals.empty() ||
+                individuals.find(sample) != individuals.end()){
+            individual_map.insert(std::pair<unsigned int, std::string>(index, sample));
             individual_indices.push_back(index);
         }
         ++index;
     }
+    individual_runs.assign(individual_indices.size(), 1);
+    for(size_t i = individual_indices.size(); i-- > 1; )
+        if(individual_indices[i - 1] + 1 == individual_indices[i])
+            individual_runs[i - 1] = individual_runs[i] + 1;
     return individual_map.size();
 }
 
+void VcfFile::warn_unphased(const VcfEntry &entry){
+    ++unphased;
+    if(warned_unphased)
+        return;
+    warned_unphased = true;
+    if(shared_warned != nullptr && shared_warned->exchange(true))
+        return;
+    std::cerr << "WARNING: Detected unphased "
+        "haplotype at chrom " << entry.chromosome <<
+        " and pos " << entry.position << "!\n";
+}
+
 VcfEntry VcfFile::initialize_entry(){
-    return VcfEntry("", individual_map.size());
+    VcfEntry entry("", individual_map.size());
+    if(pack_haplotypes)
+        entry.pack_haplotypes();
+    if(track_unphased)
+        entry.unphased_individuals.resize((individual_map.size() + 63) / 64);
+    return entry;
 }
 
 bool VcfFile::parse_line(const char* line, VcfEntry &entry){
+    return parse_line(line, strlen(line), entry);
+}
+
+bool VcfFile::parse_line(const char* line, size_t length, VcfEntry &entry){
+    std::fill(entry.unphased_individuals.begin(),
+            entry.unphased_individuals.end(), 0);
+    if(!parse_fields(line, length, entry))
+        return false;
+    if(pack_haplotypes)
+        entry.pack_haplotypes();
+    return true;
+}
+
+bool VcfFile::parse_fields(const char* line, size_t length, VcfEntry &entry){
     // returns true if line is updated
-    const char *start, *end;
+    const char *start, *end, *line_end = line + length;
     unsigned int token = 0, geno_count = 0;
     start = end = line;
     auto current_indiv = individual_indices.begin();
     for(;;){
         // move end to next tab
-        end = start + strcspn(start, "\t");
+        end = (const char*)memchr(start, '\t', line_end - start);
+        if(end == nullptr)
+            end = line_end;
 
         switch (token){
             case 0:  // chromosome 
-                if(entry.chromosome.compare(0, end-start, start) != 0)
-                    entry.chromosome = std::string(start, end-start);
+                if(entry.chromosome.compare(0, std::string::npos, start, end-start) != 0)
+                    entry.chromosome.assign(start, end-start);
                 break;
 
             case 1:  // position 
@@ -95,25 +188,27 @@ bool VcfFile::parse_line(const char* line, VcfEntry &entry){
                 break;
 
             case 8:  // FORMAT
-                if(strncmp("GT", start, 2) != 0)
+                if(end - start < 2 || strncmp("GT", start, 2) != 0)
                     throw std::invalid_argument("FORMAT must start with GT");
                 break;
 
             default:  // individuals
                 if (current_indiv != individual_indices.end()
                         && token == *current_indiv){
-                    if (*start == '.'){  // unknown (either . or ./.)
+                    // characters past the end of the line read as null
+                    char first = start < line_end ? start[0] : '\0';
+                    if (first == '.'){  // unknown (either . or ./.)
                         entry.genotypes[geno_count] = 0;
                     }
                     else{
-                        if (*(start+1) != '|' && !warned_unphased){
-                            std::cerr << "WARNING: Detected unphased "
-                                "haplotype at chrom " << entry.chromosome <<
-                                " and pos " << entry.position << "!\n";
-                            warned_unphased = true;
+                        char separator = start + 1 < line_end ? start[1] : '\0';
+                        char second = start + 2 < line_end ? start[2] : '\0';
+                        if (separator != '|'){
+                            entry.mark_unphased(geno_count);
+                            warn_unphased(entry);
                         }
-                        entry.genotypes[geno_count] = (*start == '1') + 
-                            ((*(start + 2) == '1') << 1);
+                        entry.genotypes[geno_count] = (first == '1') +
+                            ((second == '1') << 1);
                     }
                     ++current_indiv;
                     ++geno_count;
@@ -121,10 +216,47 @@ bool VcfFile::parse_line(const char* line, VcfEntry &entry){
                 break;
         }
         // break if at end, else increment to start next token
-        if(*end == '\0')
+        if(end == line_end)
             break;
         start = ++end;
         ++token;
+
+        while(token > 8){
+            // nothing left to decode after the last selected individual
+            if(current_indiv == individual_indices.end())
+                return true;
+            // jump over unselected individuals, phased GT fields are 3 wide
+            for( ; token < *current_indiv; ++token){
+                if(line_end - start > 3 && start[3] == '\t' &&
+                        start[0] != '\t' && start[1] != '\t' && start[2] != '\t'){
+                    start += 4;
+                    continue;
+                }
+                end = (const char*)memchr(start, '\t', line_end - start);
+                if(end == nullptr)
+                    return true;
+                start = end + 1;
+            }
+            // decode adjacent 3 character genotypes in blocks, leaving
+            // irregular fields and the last field of the line to the switch
+            bool unphased = false;
+            size_t decoded = decode_genotypes(simd_level, start, line_end,
+                    individual_runs[current_indiv - individual_indices.begin()],
+                    &entry.genotypes[geno_count], unphased);
+            if(unphased){
+                // the kernel only reports the run, find its unphased fields
+                for(size_t i = 0; i < decoded; ++i)
+                    if(start[4 * i] != '.' && start[4 * i + 1] != '|')
+                        entry.mark_unphased(geno_count + i);
+                warn_unphased(entry);
+            }
+            if(decoded == 0)
+                break;
+            start += 4 * decoded;
+            token += decoded;
+            current_indiv += decoded;
+            geno_count += decoded;
+        }
     }
     return true;
 }
@@ -0,0 +1,191 @@
+#include "sstar2/vcf_index.h"
+#include "sstar2/gzip_stream.h"
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
+
+bool IndexChunk::operator==(const IndexChunk& rhs) const{
+    return begin == rhs.begin && end == rhs.end;
+}
+
+// little endian integers from the index
+template <typename T>
+static T read_value(std::istream &index){
+    unsigned char bytes[sizeof(T)];
+    if(!index.read((char*)bytes, sizeof(T)))
+        throw std::invalid_argument("Truncated vcf index");
+    uint64_t result = 0;
+    for(int i = sizeof(T) - 1; i >= 0; --i)
+        result = (result << 8) | bytes[i];
+    return (T)result;
+}
+
+// first bin of a level in the binning scheme
+static uint32_t first_bin(int level){
+    return ((1u << (3 * level)) - 1) / 7;
+}
+
+VcfIndex::VcfIndex(std::istream &index){
+    std::istream input(index.rdbuf());
+    std::unique_ptr<GzipStreamBuf> buffer;
+    if(is_gzipped(index)){
+        buffer.reset(new GzipStreamBuf(index));
+        input.rdbuf(buffer.get());
+    }
+    input.exceptions(std::ios::badbit);
+
+    char magic[4];
+    if(!input.read(magic, 4))
+        throw std::invalid_argument("Truncated vcf index");
+    if(std::equal(magic, magic + 4, "TBI\1"))
+        read_tabix(input);
+    else if(std::equal(magic, magic + 4, "CSI\1"))
+        read_csi(input);
+    else
+        throw std::invalid_argument("Index must be in tabix or csi format");
+}
+
+void VcfIndex::read_names(std::istream &index, uint32_t length){
+    // names are concatenated, null terminated strings
+    std::string buffer(length, '\0');
+    if(!index.read(&buffer[0], length))
+        throw std::invalid_argument("Truncated vcf index");
+    for(size_t start = 0, end; start < length; start = end + 1){
+        end = buffer.find('\0', start);
+        if(end == std::string::npos)
+            end = length;
+        names.push_back(buffer.substr(start, end - start));
+    }
+}
+
+void VcfIndex::read_tabix(std::istream &index){
+    int32_t references = read_value<int32_t>(index);
+    // skip format, column numbers, meta character and skipped lines
+    for(int i = 0; i < 6; ++i)
+        read_value<int32_t>(index);
+    read_names(index, read_value<int32_t>(index));
+    if(names.size() != (size_t)references)
+        throw std::invalid_argument("Tabix index names do not match references");
+    read_references(index);
+}
+
+void VcfIndex::read_csi(std::istream &index){
+    csi = true;
+    min_shift = read_value<int32_t>(index);
+    depth = read_value<int32_t>(index);
+    int32_t aux_length = read_value<int32_t>(index);
+    // names are only present in the tabix style auxiliary data
+    if(aux_length < 28)
+        throw std::invalid_argument("CSI index does not contain chromosome names");
+    for(int i = 0; i < 6; ++i)
+        read_value<int32_t>(index);
+    int32_t names_length = read_value<int32_t>(index);
+    if(names_length > aux_length - 28)
+        throw std::invalid_argument("Malformed csi index");
+    read_names(index, names_length);
+    index.ignore(aux_length - 28 - names_length);
+
+    int32_t references = read_value<int32_t>(index);
+    if(names.size() != (size_t)references)
+        throw std::invalid_argument("CSI index names do not match references");
+    read_references(index);
+}
+
+void VcfIndex::read_references(std::istream &index){
+    references.resize(names.size());
+    for(auto &reference : references){
+        int32_t bins = read_value<int32_t>(index);
+        for(int32_t i = 0; i < bins; ++i){
+            Bin &bin = reference.bins[read_value<uint32_t>(index)];
+            if(csi)
+                bin.loffset = read_value<uint64_t>(index);
+            bin.chunks.resize(read_value<int32_t>(index));
+            for(auto &chunk : bin.chunks){
+                chunk.begin = read_value<uint64_t>(index);
+                chunk.end = read_value<uint64_t>(index);
+            }
+        }
+        if(csi)
+            continue;
+        reference.linear.resize(read_value<int32_t>(index));
+        for(auto &offset : reference.linear)
+            offset = read_value<uint64_t>(index);
+    }
+}
+
+uint64_t VcfIndex::min_offset(const Reference &reference, unsigned long start) const{
+    // no record overlapping start can be before this offset
+    uint64_t window = start >> min_shift;
+    if(!csi){
+        if(reference.linear.empty())
+            return 0;
+        return reference.linear[std::min<uint64_t>(window, reference.linear.size() - 1)];
+    }
+    // closest bin at or before the leaf holding start
+    uint32_t bin = first_bin(depth) + window;
+    while(bin != 0){
+        if(reference.bins.count(bin) != 0)
+            break;
+        uint32_t first = (((bin - 1) >> 3) << 3) + 1;
+        bin = bin > first ? bin - 1 : (bin - 1) >> 3;
+    }
+    auto found = reference.bins.find(bin);
+    return found == reference.bins.end() ? 0 : found->second.loffset;
+}
+
+std::vector<IndexChunk> VcfIndex::query(const std::string &chromosome,
+        unsigned long start, unsigned long end) const{
+    std::vector<IndexChunk> result;
+    auto name = std::find(names.begin(), names.end(), chromosome);
+    if(name == names.end())
+        return result;
+    const Reference &reference = references[name - names.begin()];
+
+    // positions (start, end] are 0 based [start, end - 1]
+    uint64_t max_position = (uint64_t)1 << (min_shift + 3 * depth);
+    uint64_t last = std::min<uint64_t>(end, max_position);
+    if(start >= last)
+        return result;
+    --last;
+
+    uint64_t min_off = min_offset(reference, start);
+    for(int level = 0; level <= depth; ++level){
+        int shift = min_shift + 3 * (depth - level);
+        uint32_t first = first_bin(level);
+        for(uint64_t bin = first + (start >> shift);
+                bin <= first + (last >> shift); ++bin){
+            auto found = reference.bins.find(bin);
+            if(found == reference.bins.end())
+                continue;
+            for(const auto &chunk : found->second.chunks)
+                if(chunk.end > min_off)
+                    result.push_back(chunk);
+        }
+    }
+
+    std::sort(result.begin(), result.end(),
+            [](const IndexChunk &a, const IndexChunk &b){
+                return a.begin < b.begin;
+            });
+    // merge overlapping chunks
+    size_t merged = 0;
+    for(size_t i = 1; i < result.size(); ++i){
+        if(result[i].begin <= result[merged].end)
+            result[merged].end = std::max(result[merged].end, result[i].end);
+        else
+            result[++merged] = result[i];
+    }
+    if(!result.empty())
+        result.resize(merged + 1);
+    return result;
+}
+
+std::string find_index(const std::string &vcf_file){
+    for(const std::string extension : {".tbi", ".csi"}){
+        std::ifstream index(vcf_file + extension);
+        if(index.good())
+            return vcf_file + extension;
+    }
+    return "";
+}
@@ -1,4 +1,5 @@
 #include "sstar2/window.h"
+#include <limits>
 
 bool WindowGT::operator==(const WindowGT& rhs) const{
     return position == rhs.position &&
@@ -10,8 +11,52 @@ void WindowBucket::reset_bucket(unsigned int start, unsigned int end){
     this->end = end;
     site_count = 0;
     reference_count = 0;
-    for (auto &gt : genotypes)
-        gt.clear();
+    std::fill(counts.begin(), counts.end(), 0);
+    positions.clear();
+    genotypes.clear();
+    targets.clear();
+    offsets.assign(counts.size() + 1, 0);
+    sealed = true;
+}
+
+void WindowBucket::initialize(unsigned int num_targets){
+    counts.assign(num_targets, 0);
+    reset_bucket(start, end);
+}
+
+void WindowBucket::add(unsigned int target, unsigned long position, uint8_t genotype){
+    // the last bucket can extend past the window and be sealed before all
+    // its records are seen, restore the target of each genotype
+    if(sealed){
+        targets.resize(positions.size());
+        for(size_t t = 0; t < counts.size(); ++t)
+            std::fill(targets.begin() + offsets[t], targets.begin() + offsets[t+1], t);
+        sealed = false;
+    }
+    positions.push_back(position);
+    genotypes.push_back(genotype);
+    targets.push_back(target);
+    ++counts[target];
+}
+
+void WindowBucket::seal(){
+    // counting sort by target, stable so positions stay in vcf order
+    offsets.resize(counts.size() + 1);
+    offsets[0] = 0;
+    for(size_t i = 0; i < counts.size(); ++i)
+        offsets[i+1] = offsets[i] + counts[i];
+    next.assign(offsets.begin(), offsets.end() - 1);
+    sorted_positions.resize(positions.size());
+    sorted_genotypes.resize(genotypes.size());
+    for(size_t i = 0; i < targets.size(); ++i){
+        unsigned int k = next[targets[i]]++;
+        sorted_positions[k] = positions[i];
+        sorted_genotypes[k] = genotypes[i];
+    }
+    positions.swap(sorted_positions);
+    genotypes.swap(sorted_genotypes);
+    targets.clear();
+    sealed = true;
 }
 
 StepWindow::StepWindow(unsigned int window_step, unsigned int window_length) :
@@ -25,10 +70,13 @@ void StepWindow::initialize(unsigned int num_targets){
     int num_buckets = length / step;
     num_buckets += (length % step == 0) ? 0 : 1;  //ceiling operation
     buckets.resize(num_buckets);
-    // initilize size of genotype vector
+    // initilize size of genotype arenas
     for (auto &bucket : buckets){
-        bucket.genotypes.resize(num_targets);
+        bucket.initialize(num_targets);
     }
+    site_total = 0;
+    reference_total = 0;
+    target_totals.assign(num_targets, 0);
 }
 
 void StepWindow::start_window(VcfEntry &entry){
@@ -71,16 +119,20 @@ void StepWindow::record(const VcfEntry &entry,
         if(bucket->start >= entry.position || entry.position > bucket->end)
             continue;
         ++bucket->site_count;
+        ++site_total;
         if(reference_haplotypes != 0){
             ++bucket->reference_count;
+            ++reference_total;
             return;  // only care about non-ref snps
         }
-        short unsigned int gt;
+        uint8_t gt;
         unsigned int indiv = 0;
         // for each target, if gt != 0, record position and gt
         for(unsigned int target : targets){
-            if((gt = entry.genotypes[target]) != 0)
-                bucket->genotypes[indiv].emplace_back(entry.position, gt);
+            if((gt = entry.genotypes[target]) != 0){
+                bucket->add(indiv, entry.position, gt);
+                ++target_totals[indiv];
+            }
             ++indiv;
         }
         return;
@@ -88,34 +140,50 @@ void StepWindow::record(const VcfEntry &entry,
 }
 
 unsigned int StepWindow::total_snps() const{
-    unsigned int result = 0;
-    for (const auto & bucket : buckets){
-        result += bucket.site_count;
-    }
-    return result;
+    return site_total;
 }
 
 unsigned int StepWindow::reference_snps() const{
-    unsigned int result = 0;
-    for (const auto & bucket : buckets){
-        result += bucket.reference_count;
-    }
-    return result;
+    return reference_total;
 }
 
 unsigned int StepWindow::individual_snps(unsigned int individual) const{
-    unsigned int result = 0;
-    for (const auto & bucket : buckets){
-        result += bucket.genotypes[individual].size();
-    }
-    return result;
+    return target_totals[individual];
+}
+
+const std::vector<unsigned int> &StepWindow::individual_counts() const{
+    return target_totals;
+}
+
+void StepWindow::reset_bucket(WindowBucket &bucket,
+        unsigned int start, unsigned int end){
+    // remove the bucket from the running totals
+    site_total -= bucket.site_count;
+    reference_total -= bucket.reference_count;
+    for(size_t i = 0; i < bucket.counts.size(); ++i)
+        target_totals[i] -= bucket.counts[i];
+    bucket.reset_bucket(start, end);
+}
+
+void StepWindow::finish_window(){
+    for(auto &bucket : buckets)
+        if(!bucket.sealed)
+            bucket.seal();
 }
 
 void StepWindow::fill_genotypes(std::vector<WindowGT> &genotypes, int individual) const{
+    // buckets are sealed by finish_window
     for(const auto &bucket : buckets)
-        genotypes.insert(genotypes.end(),
-                bucket.genotypes[individual].begin(),
-                bucket.genotypes[individual].end());
+        for(size_t i = bucket.begin(individual); i < bucket.end_of(individual); ++i)
+            genotypes.emplace_back(bucket.positions[i], bucket.genotypes[i]);
+}
+
+bool StepWindow::region(const std::string &,
+        unsigned long &start, unsigned long &end) const{
+    // all positions are recorded
+    start = 0;
+    end = std::numeric_limits<unsigned long>::max();
+    return true;
 }
 
 void StepWindow::reset(std::string &chrom){
@@ -124,13 +192,13 @@ void StepWindow::reset(std::string &chrom){
     end = length;
     callable_bases.set(chrom, start, end);
     for(unsigned int i = 0; i < buckets.size(); ++i)
-        buckets[i].reset_bucket(i*step, (i+1)*step);
+        reset_bucket(buckets[i], i*step, (i+1)*step);
 }
 
 void StepWindow::next(){
     // increment start and end, prepare bucket
     start += step;
-    buckets[0].reset_bucket(buckets.back().end,
+    reset_bucket(buckets[0], buckets.back().end,
             buckets.back().end + step);
     end += step;
     // update callable_bases
@@ -151,13 +219,18 @@ std::ostream& operator<<(std::ostream &strm, const WindowBucket &bucket){
     strm << "\tstart: " << bucket.start << "\tend: " << bucket.end << "\n\twith "
         << bucket.site_count << " sites\t " << bucket.reference_count
         << " references\n";
-    int indiv = 0;
-    for (const auto &genotype : bucket.genotypes){
+    for (unsigned int indiv = 0; indiv < bucket.counts.size(); ++indiv){
         strm << "\t\tindiv " << indiv << "\t";
-        for (const auto &gt : genotype)
-            strm << "(" << gt.position << ", " << gt.genotype << ")\t";
+        for (size_t i = 0; i < bucket.positions.size(); ++i){
+            // before sealing, genotypes are in record order
+            bool in_target = bucket.sealed ?
+                i >= bucket.begin(indiv) && i < bucket.end_of(indiv) :
+                bucket.targets[i] == indiv;
+            if(in_target)
+                strm << "(" << bucket.positions[i] << ", "
+                    << (int)bucket.genotypes[i] << ")\t";
+        }
         strm << "\n";
-        ++indiv;
     }
     return strm;
 }
@@ -215,19 +288,58 @@ void RangedWindow::reset(std::string &chrom){
     }
     start = window_start;
     end = start + length;
-    callable_bases.set(chrom, start, end);
+    callable_bases.set(chrom, start, std::min(end, window_end));
     for(unsigned int i = 0; i < buckets.size(); ++i)
-        buckets[i].reset_bucket(start + i*step, start + (i+1)*step);
+        reset_bucket(buckets[i], start + i*step, start + (i+1)*step);
+    if(chromosome.empty())
+        skipped = chrom;
+    else if(start >= window_end)  // empty region
+        skip();
 }
 
 void RangedWindow::next(){
-    // TODO how to deal with end and buckets?
+    if(chromosome.empty())  // reading through a skipped chromosome
+        return;
+    if(start + step >= window_end){  // past region
+        skip();
+        return;
+    }
+    StepWindow::next();
+    callable_bases.set(chromosome, start, std::min(end, window_end));
+}
+
+void RangedWindow::skip(){
+    // read the rest of the chromosome without recording
+    skipped = chromosome;
+    chromosome = "";
+    for(auto &bucket : buckets)
+        reset_bucket(bucket, bucket.start, bucket.end);
 }
 
 bool RangedWindow::should_break(VcfEntry &entry) const{
-    return false;
+    if(chromosome.empty())
+        return entry.chromosome.compare(skipped) != 0;
+    // step through the remaining windows once past the region
+    return StepWindow::should_break(entry) || entry.position > window_end;
 }
 
 bool RangedWindow::should_record(VcfEntry &entry) const{
-    return false;
+    return !chromosome.empty() &&
+        window_start < entry.position && entry.position <= window_end;
+}
+
+bool RangedWindow::region(const std::string &chrom,
+        unsigned long &start, unsigned long &end) const{
+    if(regions.empty()){
+        start = window_start;
+        end = window_end;
+    }
+    else{
+        auto region = regions.find(chrom);
+        if(region == regions.end())
+            return false;
+        start = region->second.first;
+        end = region->second.second;
+    }
+    return start < end;
 }
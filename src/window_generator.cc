@@ -7,8 +7,30 @@ void WindowGenerator::initialize(
                 std::set<std::string> &reference,
                 std::set<std::string> &exclude){
     // sets up vcf file and population data to prepare for returning
+    initialize(std::unique_ptr<LineSource>(
+                new IstreamLineSource(vcf_input)),
+            pop_file, target, reference, exclude);
+}
+
+void WindowGenerator::initialize(
+                std::unique_ptr<LineSource> vcf_input,
+                std::istream &pop_file,
+                std::set<std::string> &target,
+                std::set<std::string> &reference,
+                std::set<std::string> &exclude){
+    initialize(std::unique_ptr<RecordSource>(
+                new VcfRecordSource(std::move(vcf_input))),
+            pop_file, target, reference, exclude);
+}
+
+void WindowGenerator::initialize(
+                std::unique_ptr<RecordSource> vcf_input,
+                std::istream &pop_file,
+                std::set<std::string> &target,
+                std::set<std::string> &reference,
+                std::set<std::string> &exclude){
     population.read_data(pop_file, target, reference, exclude);
-    vcf = &vcf_input;
+    vcf = std::move(vcf_input);
     initialize_vcf();
     window->initialize(targets.size());
 }
@@ -19,14 +41,10 @@ void WindowGenerator::initialize_vcf(){
     individuals.insert(population.targets.begin(), population.targets.end());
     individuals.insert(population.references.begin(), population.references.end());
     individuals.insert(population.excluded.begin(), population.excluded.end());
-    while(std::getline(*vcf, vcf_string)){
-        if(vcf_string[1] != '#'){
-            // setup indiviual mapping
-            vcf_file.initialize_individuals(vcf_string, individuals);
-            // setup entry
-            vcf_line = vcf_file.initialize_entry();
-            break;
-        }
+    if(vcf->read_header(vcf_file, individuals)){
+        vcf_file.set_pack_haplotypes(true);
+        // setup entry
+        vcf_line = vcf_file.initialize_entry();
     }
     // setup index into haplotype for each input
     // store target names because those will be needed later
@@ -52,14 +70,63 @@ void WindowGenerator::initialize_vcf(){
             throw std::invalid_argument("VCF file is yeilding extra individuals");
         ++ind;
     }
-    // include minimal validators
-    validators.push_back(std::unique_ptr<Validator>(
-                new FixationValidator(targets, references)));
+    fixation = FixationValidator(targets, references);
+    excluded_mask = HaplotypeMask(excluded);
     // read first line
+    if(seeking)
+        find_regions();
     next_line();
 }
 
+void WindowGenerator::set_index(const VcfIndex &vcf_index){
+    index = &vcf_index;
+    seeking = true;
+}
+
+void WindowGenerator::set_chromosome(const std::string &chromosome,
+        uint64_t offset){
+    only_chromosome = chromosome;
+    chromosome_offset = offset;
+    seeking = true;
+}
+
+void WindowGenerator::find_regions(){
+    // regions of the window with records, in vcf order
+    unsigned long start, end;
+    if(index == nullptr){
+        if(window->region(only_chromosome, start, end))
+            regions.push_back({only_chromosome, start, end, chromosome_offset});
+    }
+    else{
+        for(const auto &chromosome : index->chromosomes()){
+            if(!only_chromosome.empty() && chromosome != only_chromosome)
+                continue;
+            if(!window->region(chromosome, start, end))
+                continue;
+            auto chunks = index->query(chromosome, start, end);
+            if(!chunks.empty())
+                regions.push_back({chromosome, start, end, chunks.front().begin});
+        }
+    }
+    next_region();
+}
+
+bool WindowGenerator::next_region(){
+    // seek to the next region, false after the last region
+    if(next_region_index == regions.size()){
+        input_done = true;
+        return false;
+    }
+    vcf->seek(regions[next_region_index++].offset);
+    return true;
+}
+
 void WindowGenerator::add_validator(std::unique_ptr<Validator> validator){
+    auto as_mask = dynamic_cast<MaskValidator*>(validator.get());
+    if(as_mask != nullptr && mask == nullptr)
+        mask = as_mask;
+    else
+        record_validators.push_back(validator.get());
     validators.push_back(std::move(validator));
 }
 
@@ -70,6 +137,8 @@ bool WindowGenerator::next_window(){
 
     if(terminated){
         // free validators
+        mask = nullptr;
+        record_validators.clear();
         for(auto & validator : validators)
             validator.reset();
         window.reset();
@@ -80,45 +149,79 @@ bool WindowGenerator::next_window(){
 
     do {
         if(window->should_break(vcf_line)){
+            window->finish_window();
             return true;
         }
 
         // validate other properties
-        if(window->should_record(vcf_line) && entry_is_valid()){
-            unsigned int ref_haps = vcf_line.count_haplotypes(references);
+        unsigned int ref_haps;
+        if(window->should_record(vcf_line) && entry_is_valid(ref_haps))
             window->record(vcf_line, targets, ref_haps);
-        }
 
     }while(next_line());
     // at this point, no more lines are available, but the window is valid
     // need to record no lines are left and return false the next time...
     terminated = true;  // for next time
+    window->finish_window();
     return true;
 }
 
 bool WindowGenerator::next_line(){
     // updates vcf_line to new value, returns true when the line is valid
     // false when the end of file was reached
-    while(std::getline(*vcf, vcf_string)){
-        if(! vcf_file.parse_line(vcf_string.c_str(), vcf_line))
+    bool past_region = false;
+    if(seek_pending){
+        seek_pending = false;
+        if(!next_region())
+            return false;
+    }
+    for(;;){
+        if(input_done)
+            return false;
+        if(!vcf->next_record(vcf_file, vcf_line)){
+            if(!seeking || !next_region())
+                return false;
             continue;
-        if(vcf_line.any_haplotype(excluded))
+        }
+        if(seeking){
+            const auto &region = regions[next_region_index - 1];
+            if(vcf_line.chromosome != region.chromosome){
+                if(!next_region())
+                    return false;
+                continue;
+            }
+            if(vcf_line.position > region.end)
+                past_region = true;
+            else if(vcf_line.position <= region.start)
+                continue;
+        }
+        if(vcf_line.any_haplotype(excluded_mask))
             continue;
+        // the window steps to the end of the region on the first record
+        // past it, as when reading the whole file, then seek for the next
+        seek_pending = past_region;
         return true;
     }
-    return false;
 }
 
-bool WindowGenerator::entry_is_valid(){
-    for (auto &validator : validators)
-        if(! validator->isValid(vcf_line))
+bool WindowGenerator::entry_is_valid(unsigned int &reference_haplotypes){
+    // the reference count is shared with record
+    if(!fixation.isSegregating(vcf_line, reference_haplotypes))
+        return false;
+    if(mask != nullptr && !mask->isValid(vcf_line))
+        return false;
+    for(auto validator : record_validators)
+        if(!validator->isValid(vcf_line))
             return false;
     return true;
 }
 
 unsigned int WindowGenerator::callable_length(){
-    for(auto const &validator : validators){
-        validator->updateCallable(window->callable_bases);
-    }
-    return window->callable_bases.totalLength();
+    // the window sets callable bases to its clipped (start, end]
+    auto &bases = window->callable_bases;
+    auto chrom = bases.getChromosome();
+    unsigned long start;
+    if(!bases.getStart(chrom, start))
+        return 0;
+    return callable_index.length(chrom, start, bases.getEnd(chrom), validators);
 }
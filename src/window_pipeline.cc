@@ -0,0 +1,97 @@
+#include "sstar2/window_pipeline.h"
+#include <thread>
+
+WindowPipeline::WindowPipeline(const SStarCaller &caller, unsigned int workers,
+        unsigned int windows_in_flight) :
+    caller(caller), workers(std::max(workers, 1u)),
+    slots(std::max(windows_in_flight, 1u)) {}
+
+void WindowPipeline::read(WindowGenerator &generator){
+    // fill empty slots with snapshots of each window
+    try{
+        while(generator.next_window()){
+            std::unique_lock<std::mutex> lock(mutex);
+            slot_free.wait(lock, [&]{ return next_read - next_write < slots.size(); });
+            Slot &slot = slots[next_read % slots.size()];
+            lock.unlock();
+
+            if(!caller.take_snapshot(generator, slot.snapshot))
+                continue;  // nothing to write for this window
+
+            lock.lock();
+            slot.state = SlotState::filled;
+            ++next_read;
+            lock.unlock();
+            slot_filled.notify_one();
+        }
+    }
+    catch(...){
+        std::lock_guard<std::mutex> lock(mutex);
+        read_error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reading_done = true;
+    }
+    slot_filled.notify_all();
+    slot_scored.notify_all();
+}
+
+void WindowPipeline::score(){
+    // format filled slots until the reader is finished
+    TargetScratch scratch;
+    for(;;){
+        std::unique_lock<std::mutex> lock(mutex);
+        slot_filled.wait(lock, [&]{ return next_score < next_read || reading_done; });
+        if(next_score == next_read)
+            return;  // reading is done and no windows are left
+        Slot &slot = slots[next_score % slots.size()];
+        ++next_score;
+        slot.state = SlotState::scoring;
+        lock.unlock();
+
+        scratch.row.clear();
+        caller.write_snapshot(scratch.row, slot.snapshot, scratch);
+        slot.text.assign(scratch.row.data(), scratch.row.size());
+
+        lock.lock();
+        slot.state = SlotState::scored;
+        lock.unlock();
+        slot_scored.notify_all();
+    }
+}
+
+void WindowPipeline::run(WindowGenerator &generator, std::ostream &output){
+    std::thread reader(&WindowPipeline::read, this, std::ref(generator));
+    std::vector<std::thread> scorers;
+    for(unsigned int i = 0; i < workers; ++i)
+        scorers.emplace_back(&WindowPipeline::score, this);
+
+    // write slots in window order
+    for(;;){
+        std::unique_lock<std::mutex> lock(mutex);
+        slot_scored.wait(lock, [&]{
+                return (next_write < next_read &&
+                    slots[next_write % slots.size()].state == SlotState::scored) ||
+                (reading_done && next_write == next_read);
+                });
+        if(next_write == next_read)
+            break;
+        Slot &slot = slots[next_write % slots.size()];
+        lock.unlock();
+
+        output.write(slot.text.data(), slot.text.size());
+
+        lock.lock();
+        slot.state = SlotState::empty;
+        ++next_write;
+        lock.unlock();
+        slot_free.notify_one();
+    }
+
+    reader.join();
+    for(auto &scorer : scorers)
+        scorer.join();
+    if(read_error)
+        std::rethrow_exception(read_error);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+
+#include "sstar2/batch_config.h"
+
+using testing::ElementsAre;
+
+TEST(BatchConfig, CanReadAnalyses){
+    std::istringstream input(
+            "# comparisons against africa\n"
+            "[eur]\n"
+            "targets = EUR\n"
+            "references = AFR, YRI\n"
+            "output = eur.tsv\n"
+            "\n"
+            "[ eas ]\n"
+            "targets=EAS,msp_1\n"
+            "references=AFR\n"
+            "excluded = SAS\n"
+            "include-bed = include.bed\n"
+            "exclude-bed = exclude.bed, segdup.bed\n"
+            "output = eas.tsv\n");
+    auto analyses = read_batch_config(input);
+    ASSERT_EQ(analyses.size(), 2);
+
+    EXPECT_EQ(analyses[0].name, "eur");
+    EXPECT_THAT(analyses[0].targets, ElementsAre("EUR"));
+    EXPECT_THAT(analyses[0].references, ElementsAre("AFR", "YRI"));
+    EXPECT_THAT(analyses[0].excluded, ElementsAre());
+    EXPECT_THAT(analyses[0].include_beds, ElementsAre());
+    EXPECT_EQ(analyses[0].output, "eur.tsv");
+
+    EXPECT_EQ(analyses[1].name, "eas");
+    EXPECT_THAT(analyses[1].targets, ElementsAre("EAS", "msp_1"));
+    EXPECT_THAT(analyses[1].excluded, ElementsAre("SAS"));
+    EXPECT_THAT(analyses[1].include_beds, ElementsAre("include.bed"));
+    EXPECT_THAT(analyses[1].exclude_beds, ElementsAre("exclude.bed", "segdup.bed"));
+    EXPECT_EQ(analyses[1].output, "eas.tsv");
+}
+
+TEST(BatchConfig, ThrowsOnInvalidConfig){
+    auto read = [](const std::string &config){
+        std::istringstream input(config);
+        return read_batch_config(input);
+    };
+    std::string analysis = "targets = EUR\nreferences = AFR\noutput = out\n";
+    ASSERT_NO_THROW(read("[a]\n" + analysis));
+    ASSERT_THROW(read(""), std::invalid_argument);
+    ASSERT_THROW(read("targets = EUR\n"), std::invalid_argument);
+    ASSERT_THROW(read("[a\n" + analysis), std::invalid_argument);
+    ASSERT_THROW(read("[]\n" + analysis), std::invalid_argument);
+    ASSERT_THROW(read("[a]\n" + analysis + "[a]\n" + analysis),
+            std::invalid_argument);
+    ASSERT_THROW(read("[a]\n" + analysis + "threads = 2\n"),
+            std::invalid_argument);
+    ASSERT_THROW(read("[a]\n" + analysis + "EUR\n"), std::invalid_argument);
+    // missing required keys
+    ASSERT_THROW(read("[a]\nreferences = AFR\noutput = out\n[b]\n" + analysis),
+            std::invalid_argument);
+    ASSERT_THROW(read("[a]\ntargets = EUR\noutput = out\n"),
+            std::invalid_argument);
+    ASSERT_THROW(read("[a]\ntargets = EUR\nreferences = AFR\n"),
+            std::invalid_argument);
+
+    try{
+        read("[a]\n" + analysis + "bad line\n");
+        FAIL();
+    }
+    catch(const std::invalid_argument &error){
+        EXPECT_THAT(error.what(), testing::HasSubstr("line 5"));
+    }
+}
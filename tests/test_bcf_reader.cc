@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+
+#include "sstar2/bcf_reader.h"
+
+using testing::ElementsAre;
+
+// writes bcf records with little endian fields
+class BcfWriter{
+    public:
+        std::string data;
+        template <typename T>
+        BcfWriter& add(T value){
+            data.append((const char*)&value, sizeof(T));
+            return *this;
+        }
+        BcfWriter& typed_string(const std::string &value){
+            data += (char)(value.size() << 4 | 7);
+            data += value;
+            return *this;
+        }
+        void header(const std::string &text){
+            data = std::string("BCF\2\2", 5);
+            add((uint32_t)text.size() + 1);
+            data += text;
+            data += '\0';
+        }
+        // record with GT from alleles as (allele + 1) << 1 | phased
+        template <typename T>
+        void record(int32_t chromosome, int32_t position,
+                std::vector<std::string> alleles, int8_t format,
+                size_t ploidy, std::vector<T> genotypes){
+            BcfWriter shared, individual;
+            shared.add(chromosome).add(position - 1).add((int32_t)1)
+                .add(0.0f).add((uint32_t)alleles.size() << 16)
+                .add((uint32_t)(1 << 24 | genotypes.size() / ploidy));
+            shared.typed_string("");
+            for(const auto &allele : alleles)
+                shared.typed_string(allele);
+            shared.add((int8_t)0);  // no filters
+            individual.add((uint8_t)0x11).add(format);
+            individual.add((uint8_t)(ploidy << 4 | (sizeof(T) == 1 ? 1 : 2)));
+            for(auto genotype : genotypes)
+                individual.add(genotype);
+            add((uint32_t)shared.data.size()).add((uint32_t)individual.data.size());
+            data += shared.data + individual.data;
+        }
+        // record without FORMAT fields
+        void sites(int32_t chromosome, int32_t position,
+                std::vector<std::string> alleles, size_t samples){
+            BcfWriter shared;
+            shared.add(chromosome).add(position - 1).add((int32_t)1)
+                .add(0.0f).add((uint32_t)alleles.size() << 16)
+                .add((uint32_t)samples);
+            shared.typed_string("");
+            for(const auto &allele : alleles)
+                shared.typed_string(allele);
+            shared.add((int8_t)0);  // no filters
+            add((uint32_t)shared.data.size()).add((uint32_t)0);
+            data += shared.data;
+        }
+};
+
+class BcfReaderTest : public ::testing::Test{
+    protected:
+        BcfWriter bcf;
+        VcfFile vcf_file;
+
+        void SetUp() override {
+            // GT is 3 after PASS, DP and the implicit filter from IDX
+            bcf.header(
+                    "##fileformat=VCFv4.2\n"
+                    "##contig=<ID=1,length=100>\n"
+                    "##contig=<ID=X,length=100,IDX=2>\n"
+                    "##INFO=<ID=DP,Number=1,Type=Integer,Description=\"\">\n"
+                    "##FORMAT=<ID=DP,Number=1,Type=Integer,Description=\"\">\n"
+                    "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"\",IDX=3>\n"
+                    "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\t"
+                    "msp_0\tmsp_1\tmsp_2\n");
+        }
+};
+
+TEST_F(BcfReaderTest, CanReadRecords){
+    // 0|1 1|1 0|0
+    bcf.record<int8_t>(0, 10, {"A", "T"}, 3, 2, {2, 5, 4, 5, 2, 3});
+    // not a snp
+    bcf.record<int8_t>(0, 20, {"AC", "T"}, 3, 2, {4, 5, 4, 5, 4, 5});
+    bcf.record<int8_t>(0, 25, {"A", "T", "G"}, 3, 2, {4, 5, 4, 5, 4, 5});
+    // ./. 1|0 0|1 as int16
+    bcf.record<int16_t>(2, 30, {"C", "G"}, 3, 2, {0, 1, 4, 3, 2, 5});
+    // no alternative allele
+    bcf.record<int8_t>(2, 40, {"C"}, 3, 2, {2, 3, 2, 3, 2, 3});
+    std::istringstream input(bcf.data);
+    ASSERT_TRUE(is_bcf(input));
+
+    BcfRecordSource reader(input);
+    ASSERT_TRUE(reader.read_header(vcf_file, {"msp_0", "msp_1", "msp_2"}));
+    ASSERT_EQ(vcf_file.individual_map.size(), 3);
+    VcfEntry entry = vcf_file.initialize_entry();
+
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_EQ(entry.chromosome, "1");
+    ASSERT_EQ(entry.position, 10);
+    ASSERT_EQ(entry.reference, 'A');
+    ASSERT_EQ(entry.alternative, 'T');
+    ASSERT_THAT(entry.genotypes, ElementsAre(2, 3, 0));
+
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_EQ(entry.chromosome, "X");
+    ASSERT_EQ(entry.position, 30);
+    ASSERT_THAT(entry.genotypes, ElementsAre(0, 1, 2));
+
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_EQ(entry.position, 40);
+    ASSERT_EQ(entry.alternative, '.');
+    ASSERT_FALSE(reader.next_record(vcf_file, entry));
+}
+
+TEST_F(BcfReaderTest, SitesOnlyRecordsAreMissing){
+    // 0|1 1|1 1|0, then no genotypes, then 1|1 0|0 0|1
+    bcf.record<int8_t>(0, 10, {"A", "T"}, 3, 2, {2, 5, 4, 5, 4, 3});
+    bcf.sites(0, 20, {"C", "G"}, 3);
+    bcf.record<int8_t>(0, 30, {"G", "A"}, 3, 2, {4, 5, 2, 3, 2, 5});
+    std::istringstream input(bcf.data);
+    BcfRecordSource reader(input);
+    ASSERT_TRUE(reader.read_header(vcf_file, {}));
+    vcf_file.set_pack_haplotypes(true);
+    VcfEntry entry = vcf_file.initialize_entry();
+
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_THAT(entry.genotypes, ElementsAre(2, 3, 1));
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_EQ(entry.position, 20);
+    ASSERT_THAT(entry.genotypes, ElementsAre(0, 0, 0));
+    ASSERT_THAT(entry.first_haplotype, ElementsAre(0));
+    ASSERT_THAT(entry.second_haplotype, ElementsAre(0));
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_EQ(entry.position, 30);
+    ASSERT_THAT(entry.genotypes, ElementsAre(3, 0, 2));
+    ASSERT_FALSE(reader.next_record(vcf_file, entry));
+}
+
+TEST_F(BcfReaderTest, CanSelectIndividuals){
+    // 0|1 1|1 1
+    bcf.record<int8_t>(0, 10, {"A", "T"}, 3, 2, {2, 5, 4, 5, 4, -127});
+    std::istringstream input(bcf.data);
+    BcfRecordSource reader(input);
+    vcf_file.set_pack_haplotypes(true);
+    ASSERT_TRUE(reader.read_header(vcf_file, {"msp_0", "msp_2"}));
+    VcfEntry entry = vcf_file.initialize_entry();
+
+    // haploid genotypes are unphased
+    testing::internal::CaptureStderr();
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_THAT(entry.genotypes, ElementsAre(2, 1));
+    ASSERT_TRUE(entry.is_packed());
+    ASSERT_STREQ(testing::internal::GetCapturedStderr().c_str(),
+            "WARNING: Detected unphased haplotype at chrom 1 and pos 10!\n");
+}
+
+TEST_F(BcfReaderTest, WarnsUnphasedOnce){
+    // 0/1 ./. 1|1, missing alleles are not unphased
+    bcf.record<int8_t>(0, 10, {"A", "T"}, 3, 2, {2, 4, 0, 0, 4, 5});
+    bcf.record<int8_t>(0, 20, {"A", "T"}, 3, 2, {2, 4, 0, 0, 4, 5});
+    std::istringstream input(bcf.data);
+    BcfRecordSource reader(input);
+    ASSERT_TRUE(reader.read_header(vcf_file, {}));
+    VcfEntry entry = vcf_file.initialize_entry();
+
+    testing::internal::CaptureStderr();
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_THAT(entry.genotypes, ElementsAre(2, 0, 3));
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_STREQ(testing::internal::GetCapturedStderr().c_str(),
+            "WARNING: Detected unphased haplotype at chrom 1 and pos 10!\n");
+}
+
+TEST_F(BcfReaderTest, ThrowsOnInvalidInput){
+    // DP before GT
+    bcf.record<int8_t>(0, 10, {"A", "T"}, 2, 1, {7, 7, 7});
+    std::istringstream input(bcf.data);
+    BcfRecordSource reader(input);
+    ASSERT_TRUE(reader.read_header(vcf_file, {}));
+    VcfEntry entry = vcf_file.initialize_entry();
+    ASSERT_THROW(reader.next_record(vcf_file, entry), std::invalid_argument);
+
+    std::istringstream truncated(bcf.data.substr(0, bcf.data.size() - 2));
+    BcfRecordSource truncated_reader(truncated);
+    VcfFile truncated_file;
+    ASSERT_TRUE(truncated_reader.read_header(truncated_file, {}));
+    ASSERT_THROW(truncated_reader.next_record(truncated_file, entry),
+            std::invalid_argument);
+
+    std::istringstream text("##fileformat=VCFv4.2\n");
+    ASSERT_FALSE(is_bcf(text));
+    BcfRecordSource text_reader(text);
+    ASSERT_THROW(text_reader.read_header(vcf_file, {}), std::invalid_argument);
+}
+
+TEST_F(BcfReaderTest, CanScanChromosomes){
+    size_t header_size = bcf.data.size();
+    bcf.record<int8_t>(0, 10, {"A", "T"}, 3, 2, {2, 5, 4, 5, 2, 3});
+    bcf.record<int8_t>(0, 20, {"A", "T"}, 3, 2, {2, 5, 4, 5, 2, 3});
+    size_t x_start = bcf.data.size();
+    bcf.record<int8_t>(2, 5, {"G", "C"}, 3, 2, {4, 5, 2, 3, 2, 3});
+    std::istringstream input(bcf.data);
+    BcfRecordSource reader(input);
+    ASSERT_TRUE(reader.read_header(vcf_file, {}));
+    auto chromosomes = reader.scan_chromosomes();
+    ASSERT_EQ(chromosomes.size(), 2);
+    ASSERT_EQ(chromosomes[0].name, "1");
+    ASSERT_EQ(chromosomes[0].offset, header_size);
+    ASSERT_EQ(chromosomes[1].name, "X");
+    ASSERT_EQ(chromosomes[1].offset, x_start);
+
+    VcfEntry entry = vcf_file.initialize_entry();
+    reader.seek(x_start);
+    ASSERT_TRUE(reader.next_record(vcf_file, entry));
+    ASSERT_EQ(entry.chromosome, "X");
+    ASSERT_THAT(entry.genotypes, ElementsAre(3, 0, 0));
+
+    bcf.record<int8_t>(0, 30, {"A", "T"}, 3, 2, {2, 5, 4, 5, 2, 3});
+    std::istringstream unsorted(bcf.data);
+    BcfRecordSource unsorted_reader(unsorted);
+    VcfFile unsorted_file;
+    ASSERT_TRUE(unsorted_reader.read_header(unsorted_file, {}));
+    ASSERT_THROW(unsorted_reader.scan_chromosomes(), std::invalid_argument);
+}
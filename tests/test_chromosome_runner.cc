@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+#include <thread>
+#include <chrono>
+
+#include "sstar2/chromosome_runner.h"
+
+TEST(ChromosomeRunner, CanScanChromosomes){
+    std::string vcf_str = (
+            "##fileformat=VCFv4.2\n"
+            "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tmsp_0\n"
+            "1\t1\t.\tA\tT\t.\tPASS\t.\tGT\t0|0\n"
+            "1\t2\t.\tA\tT\t.\tPASS\t.\tGT\t0|1\n"
+            "2\t5\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\n"
+            "X\t3\t.\tA\tT\t.\tPASS\t.\tGT\t1|1\n"
+            "X\t9\t.\tA\tT\t.\tPASS\t.\tGT\t1|1\n");
+    std::istringstream vcf(vcf_str);
+    auto chromosomes = scan_chromosomes(vcf);
+    ASSERT_EQ(chromosomes.size(), 3);
+
+    std::vector<std::string> expected{"1\t1\t", "2\t5\t", "X\t3\t"};
+    for(size_t i = 0; i < chromosomes.size(); ++i){
+        ASSERT_EQ(chromosomes[i].chromosome, expected[i].substr(0, 1));
+        ASSERT_EQ(chromosomes[i].offset, vcf_str.find(expected[i]));
+    }
+
+    std::istringstream unsorted(vcf_str + "2\t9\t.\tA\tT\t.\tPASS\t.\tGT\t1|1\n");
+    ASSERT_THROW(scan_chromosomes(unsorted), std::invalid_argument);
+}
+
+TEST(ChromosomeRunner, CanConcatenateInOrder){
+    std::vector<ChromosomeStart> chromosomes;
+    std::string expected;
+    for(int i = 0; i < 12; ++i){
+        chromosomes.push_back({std::to_string(i), (uint64_t)i});
+        if(i % 4 != 3)  // some chromosomes have no output
+            expected += std::to_string(i) + "\n" + std::to_string(i) + "\n";
+    }
+
+    for(unsigned int threads : {1, 2, 5}){
+        ChromosomeRunner runner(threads);
+        std::ostringstream output;
+        runner.run(chromosomes, output,
+                [](const ChromosomeStart &chromosome, std::ostream &out){
+                    if(chromosome.offset % 4 == 3)
+                        return;
+                    out << chromosome.chromosome << '\n';
+                    // finish out of order
+                    std::this_thread::sleep_for(std::chrono::milliseconds(
+                                (7 * chromosome.offset) % 5));
+                    out << chromosome.chromosome << '\n';
+                });
+        ASSERT_EQ(output.str(), expected);
+    }
+}
+
+TEST(ChromosomeRunner, RethrowsErrors){
+    std::vector<ChromosomeStart> chromosomes{{"1", 0}, {"2", 1}, {"3", 2}};
+    ChromosomeRunner runner(2);
+    std::ostringstream output;
+    ASSERT_THROW(runner.run(chromosomes, output,
+                [](const ChromosomeStart &chromosome, std::ostream &){
+                    if(chromosome.chromosome == "2")
+                        throw std::invalid_argument("bad chromosome");
+                }), std::invalid_argument);
+}
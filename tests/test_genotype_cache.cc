@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+#include <fstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sstar2/genotype_cache.h"
+
+using testing::ElementsAre;
+
+class GenotypeCacheTest : public ::testing::Test{
+    protected:
+        std::string vcf_str = (
+                "##fileformat=VCFv4.2\n"
+                "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\t"
+                "msp_0\tmsp_1\tmsp_2\n"
+                "1\t10\t.\tA\tT\t.\tPASS\t.\tGT\t0|1\t1|1\t0|0\n"
+                "1\t20\t.\tAC\tT\t.\tPASS\t.\tGT\t1|1\t1|1\t1|1\n"
+                "1\t30\t.\tC\tG\t.\tPASS\t.\tGT\t.\t1|0\t0|1\n"
+                "2\t5\t.\tG\tA\t.\tPASS\t.\tGT:DP\t1|0:3\t0|0:1\t1|1:2\n"
+                "X\t7\t.\tT\tC\t.\tPASS\t.\tGT\t0|0\t0|1\t1|0\n");
+        std::string filename;
+
+        void SetUp() override {
+            filename = "/tmp/sstar2_cache_XXXXXX";
+            close(mkstemp(&filename[0]));
+        }
+        void TearDown() override {
+            unlink(filename.c_str());
+        }
+        void write(const std::string &vcf){
+            std::istringstream input(vcf);
+            VcfRecordSource records(std::unique_ptr<LineSource>(
+                        new IstreamLineSource(input)));
+            std::ofstream output(filename, std::ios::binary);
+            write_genotype_cache(records, output);
+        }
+};
+
+TEST_F(GenotypeCacheTest, CanReadRecords){
+    write(vcf_str);
+    ASSERT_TRUE(is_genotype_cache(filename));
+    GenotypeCache cache(filename);
+    ASSERT_EQ(cache.chromosomes().size(), 3);
+    std::vector<std::string> names;
+    std::vector<uint64_t> firsts, records;
+    for(const auto &chromosome : cache.chromosomes()){
+        names.push_back(chromosome.name);
+        firsts.push_back(chromosome.first);
+        records.push_back(chromosome.records);
+    }
+    ASSERT_THAT(names, ElementsAre("1", "2", "X"));
+    ASSERT_THAT(firsts, ElementsAre(0, 2, 3));
+    ASSERT_THAT(records, ElementsAre(2, 1, 1));
+
+    // same entries as parsing the vcf, for some of the individuals
+    VcfFile vcf_file, cache_file;
+    std::istringstream input(vcf_str);
+    VcfRecordSource vcf(std::unique_ptr<LineSource>(
+                new IstreamLineSource(input)));
+    std::set<std::string> individuals{"msp_0", "msp_2"};
+    ASSERT_TRUE(vcf.read_header(vcf_file, individuals));
+    ASSERT_TRUE(cache.read_header(cache_file, individuals));
+    ASSERT_EQ(cache_file.individual_map, vcf_file.individual_map);
+    cache_file.set_pack_haplotypes(true);
+    VcfEntry expected = vcf_file.initialize_entry();
+    VcfEntry entry = cache_file.initialize_entry();
+    while(vcf.next_record(vcf_file, expected)){
+        ASSERT_TRUE(cache.next_record(cache_file, entry));
+        ASSERT_EQ(entry.chromosome, expected.chromosome);
+        ASSERT_EQ(entry.position, expected.position);
+        ASSERT_EQ(entry.reference, expected.reference);
+        ASSERT_EQ(entry.alternative, expected.alternative);
+        ASSERT_EQ(entry.genotypes, expected.genotypes);
+        ASSERT_TRUE(entry.is_packed());
+    }
+    ASSERT_FALSE(cache.next_record(cache_file, entry));
+
+    cache.seek(2);
+    ASSERT_TRUE(cache.next_record(cache_file, entry));
+    ASSERT_EQ(entry.chromosome, "2");
+    ASSERT_EQ(entry.position, 5);
+    ASSERT_THAT(entry.genotypes, ElementsAre(1, 3));
+    cache.seek(1);
+    ASSERT_TRUE(cache.next_record(cache_file, entry));
+    ASSERT_EQ(entry.chromosome, "1");
+    ASSERT_EQ(entry.position, 30);
+    ASSERT_THAT(entry.genotypes, ElementsAre(0, 2));
+}
+
+TEST_F(GenotypeCacheTest, CanPackManySamples){
+    std::string header = "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+    std::string line = "4\t100\t.\tA\tT\t.\tPASS\t.\tGT";
+    for(int i = 0; i < 70; ++i){
+        header += "\tmsp_" + std::to_string(i);
+        line += i % 3 == 0 ? "\t1|0" : i % 3 == 1 ? "\t0|1" : "\t0|0";
+    }
+    write(header + "\n" + line + "\n");
+    GenotypeCache cache(filename);
+    VcfFile vcf_file;
+    ASSERT_TRUE(cache.read_header(vcf_file, {"msp_1", "msp_66", "msp_69"}));
+    VcfEntry entry = vcf_file.initialize_entry();
+    ASSERT_TRUE(cache.next_record(vcf_file, entry));
+    ASSERT_THAT(entry.genotypes, ElementsAre(2, 1, 1));
+    ASSERT_FALSE(entry.is_packed());
+}
+
+TEST_F(GenotypeCacheTest, WarnsOnUnphasedRecords){
+    std::string unphased = vcf_str;
+    unphased.replace(unphased.find("1|0\t0|1\n"), 3, "1/0");
+    std::ostringstream warnings;
+    auto old_buffer = std::cerr.rdbuf(warnings.rdbuf());
+    write(unphased);
+    std::string converted = warnings.str();
+
+    // only phased individuals selected, as when parsing the vcf
+    warnings.str("");
+    GenotypeCache cache(filename);
+    VcfFile vcf_file;
+    ASSERT_TRUE(cache.read_header(vcf_file, {"msp_0", "msp_2"}));
+    VcfEntry entry = vcf_file.initialize_entry();
+    while(cache.next_record(vcf_file, entry)) {}
+    ASSERT_EQ(vcf_file.unphased_genotypes(), 0);
+    ASSERT_EQ(warnings.str(), "");
+
+    // warned once when reading the unphased individual
+    cache.seek(0);
+    VcfFile selected_file;
+    ASSERT_TRUE(cache.read_header(selected_file, {"msp_1"}));
+    entry = selected_file.initialize_entry();
+    while(cache.next_record(selected_file, entry)) {}
+    std::cerr.rdbuf(old_buffer);
+    ASSERT_EQ(selected_file.unphased_genotypes(), 1);
+    ASSERT_EQ(warnings.str(),
+            "WARNING: Detected unphased haplotype at chrom 1 and pos 30!\n");
+    ASSERT_EQ(converted, warnings.str());
+}
+
+TEST_F(GenotypeCacheTest, ThrowsOnInvalidInput){
+    ASSERT_THROW(write(vcf_str + "1\t50\t.\tA\tT\t.\tPASS\t.\tGT\t0|1\t1|1\t0|0\n"),
+            std::invalid_argument);
+
+    {
+        std::ofstream output(filename, std::ios::binary);
+        output << vcf_str;
+    }
+    ASSERT_FALSE(is_genotype_cache(filename));
+    ASSERT_THROW(GenotypeCache cache(filename), std::invalid_argument);
+
+    write(vcf_str);
+    std::string contents;
+    {
+        std::ifstream input(filename, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(input),
+                std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream output(filename, std::ios::binary);
+        output << contents.substr(0, contents.size() - 20);
+    }
+    ASSERT_TRUE(is_genotype_cache(filename));
+    ASSERT_THROW(GenotypeCache cache(filename), std::invalid_argument);
+}
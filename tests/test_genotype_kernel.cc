@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <random>
+
+#include "sstar2/genotype_kernel.h"
+
+TEST(GenotypeKernel, CanDecodePhased){
+    std::string fields = "0|0\t0|1\t1|0\t1|1\t.|1\t1|.\t0|0\t1|1\t"
+        "1|1\t0|1\t1|0\t0|0\t1|0";
+    std::vector<uint8_t> expected{0, 2, 1, 3, 0, 1, 0, 3, 3, 2, 1, 0};
+    for(auto level : supported_simd_levels()){
+        std::vector<uint8_t> genotypes(13, 9);
+        bool unphased = false;
+        // the last field is not followed by a tab
+        ASSERT_EQ(decode_genotypes(level, fields.data(),
+                    fields.data() + fields.size(), 13, genotypes.data(),
+                    unphased), 12);
+        ASSERT_FALSE(unphased);
+        genotypes.resize(12);
+        ASSERT_EQ(genotypes, expected);
+
+        // count limits the fields decoded
+        ASSERT_EQ(decode_genotypes(level, fields.data(),
+                    fields.data() + fields.size(), 5, genotypes.data(),
+                    unphased), 5);
+    }
+}
+
+TEST(GenotypeKernel, StopsAtIrregularField){
+    std::string fields = "0|0\t0|1\t1|0\t1|1\t0|1\t1|1\t0|0\t1|1\t"
+        "1|1\t0|1\t1|0:3\t0|0\t1|0\t";
+    for(auto level : supported_simd_levels()){
+        std::vector<uint8_t> genotypes(13, 9);
+        bool unphased = false;
+        ASSERT_EQ(decode_genotypes(level, fields.data(),
+                    fields.data() + fields.size(), 13, genotypes.data(),
+                    unphased), 10);
+        ASSERT_THAT(genotypes, testing::ElementsAre(
+                    0, 2, 1, 3, 2, 3, 0, 3, 3, 2, 9, 9, 9));
+        // short fields are not mistaken for a 3 character field
+        std::string short_fields = "0\t1\t1|1\t";
+        ASSERT_EQ(decode_genotypes(level, short_fields.data(),
+                    short_fields.data() + short_fields.size(), 2,
+                    genotypes.data(), unphased), 0);
+        ASSERT_FALSE(unphased);
+    }
+}
+
+TEST(GenotypeKernel, MissingIsNotUnphased){
+    std::string fields = "0|0\t0|1\t1|0\t1|1\t./.\t1|1\t0|0\t1|1\t"
+        "1|1\t.\t\t0|1\t./.\t";
+    for(auto level : supported_simd_levels()){
+        std::vector<uint8_t> genotypes(11, 9);
+        bool unphased = false;
+        ASSERT_EQ(decode_genotypes(level, fields.data(),
+                    fields.data() + fields.size(), 11, genotypes.data(),
+                    unphased), 9);
+        ASSERT_FALSE(unphased);
+        ASSERT_EQ(decode_genotypes(level, fields.data() + 39,
+                    fields.data() + fields.size(), 2, genotypes.data(),
+                    unphased), 2);
+        ASSERT_FALSE(unphased);
+        ASSERT_THAT(genotypes, testing::ElementsAre(
+                    2, 0, 1, 3, 0, 3, 0, 3, 3, 9, 9));
+    }
+}
+
+TEST(GenotypeKernel, DetectsUnphased){
+    std::string fields = "0|0\t0|1\t1|0\t1|1\t0|1\t1|1\t0|0\t1|1\t"
+        "1|1\t0|1\t1|0\t0|0\t1|0\t0|1\t1/1\t./.\t";
+    for(auto level : supported_simd_levels()){
+        for(size_t count : {14, 16}){
+            std::vector<uint8_t> genotypes(16, 9);
+            bool unphased = false;
+            ASSERT_EQ(decode_genotypes(level, fields.data(),
+                        fields.data() + fields.size(), count,
+                        genotypes.data(), unphased), count);
+            ASSERT_EQ(unphased, count == 16);
+            ASSERT_EQ(genotypes[13], 2);
+            if(count == 16){
+                ASSERT_EQ(genotypes[14], 3);
+                ASSERT_EQ(genotypes[15], 0);
+            }
+        }
+    }
+}
+
+TEST(GenotypeKernel, MatchesScalar){
+    std::mt19937 generator(42);
+    const char alleles[] = "01.01";
+    const char separators[] = "|||/";
+    for(int trial = 0; trial < 200; ++trial){
+        std::string fields;
+        size_t count = generator() % 70;
+        for(size_t i = 0; i < count; ++i){
+            fields += alleles[generator() % 5];
+            fields += separators[generator() % 4];
+            fields += alleles[generator() % 5];
+            if(generator() % 50 == 0)
+                fields += ":1";
+            fields += '\t';
+        }
+        std::vector<uint8_t> expected(count);
+        bool expected_unphased = false;
+        size_t expected_decoded = decode_genotypes(SimdLevel::scalar,
+                fields.data(), fields.data() + fields.size(), count,
+                expected.data(), expected_unphased);
+        for(auto level : supported_simd_levels()){
+            std::vector<uint8_t> genotypes(count);
+            bool unphased = false;
+            ASSERT_EQ(decode_genotypes(level, fields.data(),
+                        fields.data() + fields.size(), count,
+                        genotypes.data(), unphased), expected_decoded);
+            ASSERT_EQ(genotypes, expected);
+            ASSERT_EQ(unphased, expected_unphased);
+        }
+    }
+}
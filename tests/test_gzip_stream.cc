@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+#include <zlib.h>
+
+#include "sstar2/gzip_stream.h"
+
+// compress data as a single gzip member, optionally as a bgzf block
+std::string compress(const std::string &data, bool bgzf){
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    deflateInit2(&stream, 6, Z_DEFLATED, bgzf ? -15 : 15 + 16, 8,
+            Z_DEFAULT_STRATEGY);
+    std::string deflated(deflateBound(&stream, data.size()) + 32, '\0');
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef*)&deflated[0];
+    stream.avail_out = deflated.size();
+    deflate(&stream, Z_FINISH);
+    deflated.resize(stream.total_out);
+    deflateEnd(&stream);
+    if(!bgzf)
+        return deflated;
+
+    auto le = [](unsigned long value, int length){
+        std::string result;
+        for(int i = 0; i < length; ++i)
+            result += (char)((value >> (8 * i)) & 0xff);
+        return result;
+    };
+    std::string block("\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0", 16);
+    block += le(deflated.size() + 25, 2);
+    block += deflated;
+    block += le(crc32(0L, (const Bytef*)data.data(), data.size()), 4);
+    block += le(data.size(), 4);
+    return block;
+}
+
+std::string read_all(std::istream &input){
+    std::ostringstream result;
+    std::string line;
+    while(std::getline(input, line))
+        result << line << '\n';
+    return result.str();
+}
+
+std::string make_lines(int count){
+    std::ostringstream lines;
+    for(int i = 0; i < count; ++i)
+        lines << "1\t" << i << "\t.\tA\tT\t.\tPASS\t.\tGT\t0|1\t1|1\n";
+    return lines.str();
+}
+
+TEST(GzipStream, DetectsGzip){
+    std::istringstream plain("#CHROM\tPOS\n");
+    ASSERT_FALSE(is_gzipped(plain));
+    ASSERT_EQ(plain.get(), '#');  // nothing consumed
+    std::istringstream compressed(compress("#CHROM\n", false));
+    ASSERT_TRUE(is_gzipped(compressed));
+}
+
+TEST(GzipStream, ReadsGzip){
+    std::string lines = make_lines(5000);
+    // concatenated members are read as one file
+    std::istringstream compressed(compress(lines, false) + compress(lines, false));
+    GzipStreamBuf buffer(compressed);
+    ASSERT_FALSE(buffer.is_bgzf());
+    std::istream input(&buffer);
+    ASSERT_EQ(read_all(input), lines + lines);
+}
+
+TEST(GzipStream, ReadsGzipWithLargeExtraField){
+    // the header with its extra field is larger than the input buffer
+    std::string lines = make_lines(100);
+    std::string member = compress(lines, false);
+    member[3] |= 4;
+    std::string extra("XY\xfb\xff", 4);
+    extra += std::string(0xfffb, 'x');
+    member.insert(10, std::string("\xff\xff", 2) + extra);
+    std::istringstream compressed(member);
+    GzipStreamBuf buffer(compressed);
+    ASSERT_FALSE(buffer.is_bgzf());
+    std::istream input(&buffer);
+    ASSERT_EQ(read_all(input), lines);
+}
+
+TEST(GzipStream, ReadsBgzf){
+    std::string lines = make_lines(20000);
+    std::string bgzf;
+    // split lines across blocks, with an empty end of file block
+    for(size_t start = 0; start < lines.size(); start += 3000)
+        bgzf += compress(lines.substr(start, 3000), true);
+    bgzf += compress("", true);
+
+    for(unsigned int threads : {1, 2, 5}){
+        std::istringstream compressed(bgzf);
+        GzipStreamBuf buffer(compressed, threads);
+        ASSERT_TRUE(buffer.is_bgzf());
+        std::istream input(&buffer);
+        ASSERT_EQ(read_all(input), lines);
+    }
+}
+
+TEST(GzipStream, ThrowsOnCorruptBgzf){
+    std::string bgzf = compress(make_lines(100), true);
+    bgzf[30] ^= 0x55;  // corrupt the deflate data
+    std::istringstream compressed(bgzf);
+    GzipStreamBuf buffer(compressed, 2);
+    std::istream input(&buffer);
+    input.exceptions(std::ios::badbit);
+    ASSERT_THROW(read_all(input), std::runtime_error);
+
+    // uncompressed size beyond the 64 KiB of a block
+    std::string oversized = compress(make_lines(100), true);
+    oversized[oversized.size() - 2] = '\x01';
+    std::istringstream oversized_compressed(oversized);
+    GzipStreamBuf oversized_buffer(oversized_compressed, 2);
+    std::istream oversized_input(&oversized_buffer);
+    oversized_input.exceptions(std::ios::badbit);
+    try{
+        read_all(oversized_input);
+        FAIL();
+    }
+    catch(const std::runtime_error &error){
+        ASSERT_STREQ(error.what(), "Malformed bgzf block");
+    }
+
+    std::istringstream truncated(compress(make_lines(100), false).substr(0, 50));
+    GzipStreamBuf truncated_buffer(truncated);
+    std::istream truncated_input(&truncated_buffer);
+    truncated_input.exceptions(std::ios::badbit);
+    ASSERT_THROW(read_all(truncated_input), std::runtime_error);
+}
+
+TEST(GzipStream, CanSeekBgzf){
+    std::vector<std::string> blocks{"1\t10\tfirst\n1\t20\tse", "cond\n",
+        "2\t5\tthird\n"};
+    std::string bgzf;
+    std::vector<uint64_t> offsets;
+    for(const auto &block : blocks){
+        offsets.push_back(bgzf.size());
+        bgzf += compress(block, true);
+    }
+    bgzf += compress("", true);
+
+    std::istringstream compressed(bgzf);
+    GzipStreamBuf buffer(compressed, 2);
+    std::istream input(&buffer);
+    std::string line;
+    buffer.seek(offsets[2] << 16);
+    ASSERT_TRUE(std::getline(input, line));
+    ASSERT_EQ(line, "2\t5\tthird");
+    ASSERT_FALSE(std::getline(input, line));
+
+    // lines can span blocks
+    input.clear();
+    buffer.seek(offsets[0] << 16 | 11);
+    ASSERT_EQ(read_all(input), "1\t20\tsecond\n2\t5\tthird\n");
+
+    input.clear();
+    ASSERT_THROW(buffer.seek(offsets[1] << 16 | 100), std::runtime_error);
+
+    std::istringstream plain(compress(blocks[0], false));
+    GzipStreamBuf plain_buffer(plain);
+    ASSERT_THROW(plain_buffer.seek(0), std::logic_error);
+}
+
+TEST(GzipStream, CanTellBgzf){
+    std::vector<std::string> blocks{"1\t10\tfirst\n1\t20\tse", "cond\n",
+        "2\t5\tthird\n"};
+    std::string bgzf;
+    for(const auto &block : blocks)
+        bgzf += compress(block, true);
+    bgzf += compress("", true);
+
+    std::istringstream compressed(bgzf);
+    GzipStreamBuf buffer(compressed);
+    std::istream input(&buffer);
+    std::vector<uint64_t> offsets;
+    std::string line;
+    for(offsets.push_back(buffer.tell()); std::getline(input, line); )
+        offsets.push_back(buffer.tell());
+    ASSERT_EQ(offsets[0], 0);
+
+    // seeking to each offset returns the following lines
+    std::vector<std::string> expected{"1\t10\tfirst", "1\t20\tsecond", "2\t5\tthird"};
+    for(size_t i = 0; i < expected.size(); ++i){
+        input.clear();
+        buffer.seek(offsets[i]);
+        ASSERT_TRUE(std::getline(input, line));
+        ASSERT_EQ(line, expected[i]);
+    }
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sstar2/line_source.h"
+
+// read all remaining lines of source
+std::vector<std::string> read_lines(LineSource &source){
+    std::vector<std::string> result;
+    const char *line;
+    size_t length;
+    while(source.next_line(line, length))
+        result.push_back(std::string(line, length));
+    return result;
+}
+
+class TemporaryFile{
+    public:
+        std::string name;
+        TemporaryFile(const std::string &contents){
+            name = "/tmp/sstar2_test_XXXXXX";
+            int descriptor = mkstemp(&name[0]);
+            close(descriptor);
+            std::ofstream file(name, std::ios::binary);
+            file << contents;
+        }
+        ~TemporaryFile(){
+            unlink(name.c_str());
+        }
+};
+
+std::string lines_str = "first\nsecond line\n\nlast";
+
+TEST(LineSource, IstreamCanReadLines){
+    std::istringstream input(lines_str);
+    IstreamLineSource source(input);
+    ASSERT_THAT(read_lines(source), testing::ElementsAre(
+                "first", "second line", "", "last"));
+
+    source.seek(6);
+    ASSERT_THAT(read_lines(source), testing::ElementsAre(
+                "second line", "", "last"));
+}
+
+TEST(LineSource, MmapCanReadLines){
+    TemporaryFile file(lines_str);
+    ASSERT_TRUE(can_mmap(file.name));
+    MmapLineSource source(file.name);
+    ASSERT_THAT(read_lines(source), testing::ElementsAre(
+                "first", "second line", "", "last"));
+
+    source.seek(6);
+    ASSERT_THAT(read_lines(source), testing::ElementsAre(
+                "second line", "", "last"));
+
+    // trailing newline does not make an empty line
+    TemporaryFile terminated("first\n");
+    MmapLineSource terminated_source(terminated.name);
+    ASSERT_THAT(read_lines(terminated_source), testing::ElementsAre("first"));
+}
+
+TEST(LineSource, MmapCanReadEmptyFile){
+    TemporaryFile file("");
+    MmapLineSource source(file.name);
+    ASSERT_THAT(read_lines(source), testing::ElementsAre());
+}
+
+TEST(LineSource, MmapThrowsOnMissingFile){
+    ASSERT_FALSE(can_mmap("/nonexistent/file.vcf"));
+    ASSERT_FALSE(can_mmap("/tmp"));
+    ASSERT_THROW(MmapLineSource source("/nonexistent/file.vcf"),
+            std::runtime_error);
+}
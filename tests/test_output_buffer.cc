@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+#include <limits>
+#include <random>
+
+#include "sstar2/output_buffer.h"
+
+// write value to both, tab separated
+template <typename T>
+void add_to(OutputBuffer &buffer, std::ostringstream &expected, T value){
+    buffer << value << '\t';
+    expected << value << '\t';
+}
+
+TEST(OutputBuffer, FormatsAsOstream){
+    OutputBuffer buffer;
+    std::ostringstream expected;
+    for(long value : {0l, 1l, -1l, 9l, 10l, 99l, 100l, -100l, 101l, 999l,
+            1000l, 123456789l, -10000l,
+            std::numeric_limits<long>::min(), std::numeric_limits<long>::max()})
+        add_to(buffer, expected, value);
+    add_to(buffer, expected, std::numeric_limits<unsigned long>::max());
+    add_to(buffer, expected, std::numeric_limits<unsigned int>::max());
+    add_to(buffer, expected, std::numeric_limits<int>::min());
+    add_to(buffer, expected, (unsigned short)3);
+    add_to(buffer, expected, "text");
+    add_to(buffer, expected, std::string("string"));
+    std::mt19937_64 random(5);
+    for(int i = 0; i < 1000; ++i){
+        add_to(buffer, expected, random() >> (i % 64));
+        add_to(buffer, expected, (long)random() >> (i % 64));
+    }
+    ASSERT_EQ(std::string(buffer.data(), buffer.size()), expected.str());
+}
+
+TEST(OutputBuffer, FlushWritesAndClears){
+    OutputBuffer buffer;
+    std::ostringstream output;
+    buffer << "chr1" << '\t' << 10ul << '\n';
+    buffer.flush(output);
+    ASSERT_EQ(buffer.size(), 0);
+    buffer << -5 << '\n';
+    buffer.flush(output);
+    ASSERT_EQ(output.str(), "chr1\t10\n-5\n");
+
+    buffer << "dropped";
+    buffer.clear();
+    buffer.flush(output);
+    ASSERT_EQ(output.str(), "chr1\t10\n-5\n");
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+
+#include "sstar2/shared_records.h"
+
+using testing::ElementsAre;
+
+class SharedRecordsTest : public ::testing::Test{
+    protected:
+        std::string vcf_str = (
+                "##fileformat=VCFv4.2\n"
+                "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\t"
+                "msp_0\tmsp_1\tmsp_2\tmsp_3\n"
+                "1\t10\t.\tA\tT\t.\tPASS\t.\tGT\t0|1\t1|1\t0|0\t1|0\n"
+                "1\t20\t.\tAC\tT\t.\tPASS\t.\tGT\t1|1\t1|1\t1|1\t1|1\n"
+                "1\t30\t.\tC\tG\t.\tPASS\t.\tGT\t0|0\t1|0\t0|1\t1|1\n"
+                "2\t5\t.\tG\tA\t.\tPASS\t.\tGT\t1|0\t0|0\t1|1\t0|1\n");
+        std::istringstream input{vcf_str};
+
+        std::unique_ptr<RecordSource> source(){
+            return std::unique_ptr<RecordSource>(new VcfRecordSource(
+                        std::unique_ptr<LineSource>(new IstreamLineSource(input))));
+        }
+};
+
+TEST_F(SharedRecordsTest, ReadersSelectTheirIndividuals){
+    SharedRecords records(source(), {"msp_1", "msp_2", "msp_3"});
+    auto first = records.reader();
+    auto second = records.reader();
+
+    VcfFile first_file, second_file;
+    ASSERT_TRUE(first->read_header(first_file, {"msp_1", "msp_3"}));
+    ASSERT_TRUE(second->read_header(second_file, {"msp_2"}));
+    ASSERT_THAT(first_file.individual_map, ElementsAre(
+                std::make_pair(10, "msp_1"), std::make_pair(12, "msp_3")));
+    ASSERT_THAT(second_file.individual_map, ElementsAre(
+                std::make_pair(11, "msp_2")));
+
+    first_file.set_pack_haplotypes(true);
+    VcfEntry first_entry = first_file.initialize_entry();
+    VcfEntry second_entry = second_file.initialize_entry();
+
+    ASSERT_TRUE(first->next_record(first_file, first_entry));
+    ASSERT_EQ(first_entry.chromosome, "1");
+    ASSERT_EQ(first_entry.position, 10);
+    ASSERT_THAT(first_entry.genotypes, ElementsAre(3, 1));
+    ASSERT_THAT(first_entry.first_haplotype, ElementsAre(3));
+    ASSERT_THAT(first_entry.second_haplotype, ElementsAre(1));
+
+    // the multiallelic record is skipped for both readers
+    ASSERT_TRUE(first->next_record(first_file, first_entry));
+    ASSERT_EQ(first_entry.position, 30);
+    ASSERT_EQ(first_entry.reference, 'C');
+    ASSERT_EQ(first_entry.alternative, 'G');
+    ASSERT_THAT(first_entry.genotypes, ElementsAre(1, 3));
+    ASSERT_EQ(first->position(), 2);
+    ASSERT_EQ(records.buffered(), 2);
+
+    ASSERT_TRUE(second->next_record(second_file, second_entry));
+    ASSERT_EQ(second_entry.position, 10);
+    ASSERT_THAT(second_entry.genotypes, ElementsAre(0));
+    ASSERT_FALSE(second_entry.is_packed());
+    ASSERT_EQ(records.buffered(), 1);
+    ASSERT_TRUE(second->next_record(second_file, second_entry));
+    ASSERT_EQ(second_entry.position, 30);
+    ASSERT_THAT(second_entry.genotypes, ElementsAre(2));
+    ASSERT_EQ(records.buffered(), 0);
+
+    ASSERT_TRUE(second->next_record(second_file, second_entry));
+    ASSERT_EQ(second_entry.chromosome, "2");
+    ASSERT_THAT(second_entry.genotypes, ElementsAre(3));
+    ASSERT_FALSE(second->next_record(second_file, second_entry));
+
+    ASSERT_TRUE(first->next_record(first_file, first_entry));
+    ASSERT_EQ(first_entry.chromosome, "2");
+    ASSERT_EQ(first_entry.position, 5);
+    ASSERT_THAT(first_entry.genotypes, ElementsAre(0, 2));
+    ASSERT_FALSE(first->next_record(first_file, first_entry));
+    ASSERT_EQ(records.buffered(), 0);
+}
+
+TEST_F(SharedRecordsTest, EmptySelectionIsAllSharedIndividuals){
+    SharedRecords records(source(), {"msp_0", "msp_3"});
+    auto reader = records.reader();
+    VcfFile vcf_file;
+    ASSERT_TRUE(reader->read_header(vcf_file, {}));
+    ASSERT_THAT(vcf_file.individual_map, ElementsAre(
+                std::make_pair(9, "msp_0"), std::make_pair(12, "msp_3")));
+    VcfEntry entry = vcf_file.initialize_entry();
+    ASSERT_TRUE(reader->next_record(vcf_file, entry));
+    ASSERT_THAT(entry.genotypes, ElementsAre(2, 1));
+}
+
+TEST_F(SharedRecordsTest, CannotSeekOrAddLateReaders){
+    SharedRecords records(source(), {"msp_0"});
+    auto reader = records.reader();
+    VcfFile vcf_file;
+    reader->read_header(vcf_file, {"msp_0"});
+    VcfEntry entry = vcf_file.initialize_entry();
+    ASSERT_THROW(reader->seek(0), std::logic_error);
+    reader->next_record(vcf_file, entry);
+    ASSERT_THROW(records.reader(), std::logic_error);
+}
+
+TEST(SharedRecords, NoHeader){
+    std::istringstream input("");
+    SharedRecords records(std::unique_ptr<RecordSource>(new VcfRecordSource(
+                    std::unique_ptr<LineSource>(new IstreamLineSource(input)))),
+            {});
+    auto reader = records.reader();
+    VcfFile vcf_file;
+    ASSERT_FALSE(reader->read_header(vcf_file, {}));
+    VcfEntry entry = vcf_file.initialize_entry();
+    ASSERT_FALSE(reader->next_record(vcf_file, entry));
+}
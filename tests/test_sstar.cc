@@ -19,6 +19,16 @@ TEST(SSTAR, CanWriteHeader){
             "callable_bases\n");
 }
 
+TEST(SSTAR, CanWriteHeaderForSettings){
+    std::ostringstream outfile;
+    SStarCaller sstar({5000}, {-10000, -5000});
+    sstar.write_header(outfile);
+    ASSERT_THAT(outfile.str(), testing::EndsWith(
+            "s_star_haps\tcallable_bases\tmatch_bonus\tmismatch_penalty\n"));
+    ASSERT_THROW(SStarCaller(std::vector<long>(), {-10000}),
+            std::invalid_argument);
+}
+
 class SStarFixtureEmpty : public ::testing::Test{
     // empty because first window contains nothing
     protected:
@@ -123,6 +133,51 @@ TEST_F(SStarFixtureNormal, CanWriteWindow){
     ASSERT_FALSE(generator.next_window());
 }
 
+TEST_F(SStarFixtureNormal, CanWriteWindowThreaded){
+    std::ostringstream outfile;
+    sstar.set_threads(3);
+    generator.next_window();
+    sstar.write_window(outfile, generator);
+    ASSERT_STREQ(outfile.str().c_str(),
+            "1\t0\t50000\t8\t4\t6\tmsp_0\tpop0\t"
+            "10035\t3\t10,30,45\t10\t45\t0\t0\t10\t45\t3\t0\t1,1,1\t50000\n"
+            "1\t0\t50000\t8\t2\t4\tmsp_2\tpop2\t"
+            "0\t0\t.\t0\t0\t0\t0\t0\t0\t0\t0\t.\t50000\n"
+            "1\t0\t50000\t8\t2\t4\tmsp_3\tpop3\t"
+            "0\t0\t.\t0\t0\t0\t0\t0\t0\t0\t0\t.\t50000\n"
+            "1\t0\t50000\t8\t1\t3\tmsp_4\tpop4\t"
+            "0\t0\t.\t0\t0\t0\t0\t0\t0\t0\t0\t.\t50000\n"
+            "1\t0\t50000\t8\t0\t2\tmsp_5\tpop5\t"
+            "0\t0\t.\t0\t0\t0\t0\t0\t0\t0\t0\t.\t50000\n"
+            );
+    ASSERT_FALSE(generator.next_window());
+}
+
+TEST_F(SStarFixtureNormal, CanWriteWindowForSettings){
+    // each target is scored for every bonus and penalty pair
+    std::ostringstream outfile;
+    SStarCaller grid({5000, 10}, {-10000});
+    generator.next_window();
+    grid.write_window(outfile, generator);
+    std::string empty = "0\t0\t.\t0\t0\t0\t0\t0\t0\t0\t0\t.\t50000\t";
+    ASSERT_EQ(outfile.str(),
+            "1\t0\t50000\t8\t4\t6\tmsp_0\tpop0\t"
+            "10035\t3\t10,30,45\t10\t45\t0\t0\t10\t45\t3\t0\t1,1,1\t50000\t"
+            "5000\t-10000\n"
+            "1\t0\t50000\t8\t4\t6\tmsp_0\tpop0\t"
+            "55\t3\t10,30,45\t10\t45\t0\t0\t10\t45\t3\t0\t1,1,1\t50000\t"
+            "10\t-10000\n"
+            "1\t0\t50000\t8\t2\t4\tmsp_2\tpop2\t" + empty + "5000\t-10000\n"
+            "1\t0\t50000\t8\t2\t4\tmsp_2\tpop2\t" + empty + "10\t-10000\n"
+            "1\t0\t50000\t8\t2\t4\tmsp_3\tpop3\t" + empty + "5000\t-10000\n"
+            "1\t0\t50000\t8\t2\t4\tmsp_3\tpop3\t" + empty + "10\t-10000\n"
+            "1\t0\t50000\t8\t1\t3\tmsp_4\tpop4\t" + empty + "5000\t-10000\n"
+            "1\t0\t50000\t8\t1\t3\tmsp_4\tpop4\t" + empty + "10\t-10000\n"
+            "1\t0\t50000\t8\t0\t2\tmsp_5\tpop5\t" + empty + "5000\t-10000\n"
+            "1\t0\t50000\t8\t0\t2\tmsp_5\tpop5\t" + empty + "10\t-10000\n"
+            );
+}
+
 TEST_F(SStarFixtureNormal, CanWriteWindowWithValidators){
     std::ostringstream outfile;
 
@@ -167,3 +222,56 @@ TEST(SStarMismatches, TiedScoreUseLonger){
                 WindowGT{7493191, 2}
         ));
 }
+
+TEST(SStarMismatches, MismatchRestartsChain){
+    std::vector<WindowGT>genotypes{
+        {1000, 3},
+        {2000, 1},
+        {3000, 1},
+        {4000, 1}};
+    SStarCaller sstar;
+    ASSERT_EQ(sstar.sstar(genotypes), 12000);
+    ASSERT_THAT(genotypes, ElementsAre(
+                WindowGT{2000, 1},
+                WindowGT{3000, 1},
+                WindowGT{4000, 1}
+        ));
+}
+
+TEST(SStarDuplicates, IdenticalTargetsAreScoredOnce){
+    std::istringstream vcf{
+        "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\t"
+        "FORMAT\tmsp_0\tmsp_1\tmsp_2\tref\n"
+        "1\t10\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\t1|0\t1|0\t0|0\n"
+        "1\t30\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\t1|0\t1|0\t0|0\n"
+        "1\t45\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\t1|0\t0|1\t0|0\n"
+        "1\t90\t.\tA\tT\t.\tPASS\t.\tGT\t0|1\t0|1\t0|0\t1|0\n"
+    };
+    std::istringstream pop{
+        "samp\tpop\tsuper_pop\n"
+        "msp_0\tpop0\ttarg\n"
+        "msp_1\tpop1\ttarg\n"
+        "msp_2\tpop2\ttarg\n"
+        "ref\t.\tref\n"
+    };
+    std::set<std::string> target{"targ"}, reference{"ref"}, exclude;
+    WindowGenerator generator{std::unique_ptr<Window>(new StepWindow(100, 100))};
+    generator.initialize(vcf, pop, target, reference, exclude);
+    ASSERT_TRUE(generator.next_window());
+
+    for(unsigned int threads : {1, 2}){
+        SStarCaller sstar;
+        sstar.set_threads(threads);
+        std::ostringstream outfile;
+        sstar.write_window(outfile, generator);
+        ASSERT_EQ(outfile.str(),
+                "1\t0\t100\t4\t3\t4\tmsp_0\tpop0\t"
+                "10035\t3\t10,30,45\t10\t45\t0\t0\t10\t45\t3\t0\t1,1,1\t100\n"
+                "1\t0\t100\t4\t3\t4\tmsp_1\tpop1\t"
+                "10035\t3\t10,30,45\t10\t45\t0\t0\t10\t45\t3\t0\t1,1,1\t100\n"
+                "1\t0\t100\t4\t3\t4\tmsp_2\tpop2\t"
+                "10035\t3\t10,30,45\t10\t30\t0\t0\t10\t45\t2\t1\t1,1,2\t100\n");
+        ASSERT_EQ(sstar.targets_scored(), 2);
+        ASSERT_EQ(sstar.targets_reused(), 1);
+    }
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <random>
+
+#include "sstar2/sstar.h"
+#include "sstar2/sstar_kernel.h"
+
+TEST(SStarKernel, PredecessorTiesKeepFirst){
+    SStarBuffer buffer;
+    buffer.resize(20);
+    // all equal scores and matching genotypes with equal distances
+    for(int i = 0; i < 20; ++i){
+        buffer.positions[i] = i < 19 ? 0 : 100;
+        buffer.genotypes[i] = 1;
+        buffer.scores[i] = 7;
+    }
+    for(auto level : supported_simd_levels()){
+        Predecessor best = best_predecessor(level, buffer, 19, 5000, -10000);
+        ASSERT_EQ(best.index, 0);
+        ASSERT_EQ(best.score, 5107);
+        ASSERT_FALSE(best.chain_start);
+    }
+}
+
+TEST(SStarKernel, PredecessorSkipsClose){
+    SStarBuffer buffer;
+    buffer.resize(12);
+    for(int i = 0; i < 12; ++i){
+        buffer.positions[i] = i;
+        buffer.genotypes[i] = 2;
+        buffer.scores[i] = -100000;
+    }
+    for(auto level : supported_simd_levels()){
+        // only j = 0 and 1 are 10 or more bp away
+        Predecessor best = best_predecessor(level, buffer, 11, 5000, -10000);
+        ASSERT_EQ(best.index, 0);
+        ASSERT_EQ(best.score, 5011);
+        ASSERT_TRUE(best.chain_start);
+        best = best_predecessor(level, buffer, 9, 5000, -10000);
+        ASSERT_EQ(best.index, -1);
+    }
+}
+
+TEST(SStarKernel, MatchesScalarSStar){
+    std::mt19937 rng(42);
+    long params[][2] = {{5000, -10000}, {0, 0}, {100, 500}, {-10, -10}};
+    for(int iter = 0; iter < 2000; ++iter){
+        std::vector<WindowGT> genotypes;
+        unsigned long position = rng() % 100;
+        int nsnps = rng() % 60 + 1;
+        for(int i = 0; i < nsnps; ++i){
+            position += rng() % (iter % 2 ? 12 : 5000) + 1;
+            genotypes.emplace_back(position, rng() % 3 + 1);
+        }
+        long *param = params[iter % 4];
+        SStarCaller scalar(param[0], param[1]);
+        scalar.set_simd_level(SimdLevel::scalar);
+        std::vector<WindowGT> expected = genotypes;
+        long expected_score = scalar.sstar(expected);
+
+        for(auto level : supported_simd_levels()){
+            SStarCaller caller(param[0], param[1]);
+            caller.set_simd_level(level);
+            std::vector<WindowGT> result = genotypes;
+            ASSERT_EQ(caller.sstar(result), expected_score);
+            ASSERT_EQ(result, expected);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <vector>
+
+#include "sstar2/thread_pool.h"
+
+TEST(ThreadPool, SingleThreadRunsInOrder){
+    ThreadPool pool(1);
+    ASSERT_EQ(pool.size(), 1);
+    std::vector<size_t> order;
+    pool.parallel_for(5, [&](size_t i, unsigned int worker){
+            ASSERT_EQ(worker, 0);
+            order.push_back(i);
+            });
+    ASSERT_THAT(order, testing::ElementsAre(0, 1, 2, 3, 4));
+}
+
+TEST(ThreadPool, RunsEachTaskOnce){
+    ThreadPool pool(4);
+    ASSERT_EQ(pool.size(), 4);
+    for(int repeat = 0; repeat < 50; ++repeat){
+        std::vector<int> counts(1000, 0);
+        std::vector<int> workers(1000, -1);
+        pool.parallel_for(counts.size(), [&](size_t i, unsigned int worker){
+                ++counts[i];
+                workers[i] = worker;
+                });
+        for(size_t i = 0; i < counts.size(); ++i){
+            ASSERT_EQ(counts[i], 1);
+            ASSERT_LT(workers[i], 4);
+        }
+    }
+    // empty ranges return immediately
+    pool.parallel_for(0, [&](size_t, unsigned int){ FAIL(); });
+}
@@ -217,40 +217,58 @@ TEST(BedValidator, NegativeBedCallable){
     ASSERT_EQ(region.totalLength(), 90);
 }
 
-TEST(FixValidator, CanValidateFixation){
+void check_fixation(bool packed){
     VcfEntry entry("", 5);
     FixationValidator valid(
             std::vector<unsigned int>{0, 2},
             std::vector<unsigned int>{3});
+    // set genotype and update the bitplanes of packed entries
+    auto set = [&](size_t individual, uint8_t genotype){
+        entry.genotypes[individual] = genotype;
+        if(packed)
+            entry.pack_haplotypes();
+    };
+    set(0, 0);
     ASSERT_FALSE(valid.isValid(entry));
     // positions 1 and 4 don't matter
     for(uint8_t i = 0; i < 4; ++i){
-        entry.genotypes[1] = i;
+        set(1, i);
         for(uint8_t j = 0; j < 4; ++j){
-            entry.genotypes[4] = j;
+            set(4, j);
             ASSERT_FALSE(valid.isValid(entry));
         }
     }
-    entry.genotypes[0] = 1;
+    set(0, 1);
     // positions 1 and 4 don't matter
     for(uint8_t i = 0; i < 4; ++i){
-        entry.genotypes[1] = i;
+        set(1, i);
         for(uint8_t j = 0; j < 4; ++j){
-            entry.genotypes[4] = j;
+            set(4, j);
             ASSERT_TRUE(valid.isValid(entry));
         }
     }
-    entry.genotypes[0] = 3;
+    set(0, 3);
     ASSERT_TRUE(valid.isValid(entry));
-    entry.genotypes[2] = 3;
+    set(2, 3);
     ASSERT_TRUE(valid.isValid(entry));
-    entry.genotypes[3] = 2;
+    set(3, 2);
     ASSERT_TRUE(valid.isValid(entry));
-    entry.genotypes[3] = 3;
+    unsigned int reference_haplotypes = 0;
+    ASSERT_TRUE(valid.isSegregating(entry, reference_haplotypes));
+    ASSERT_EQ(reference_haplotypes, 1);
+    set(3, 3);
     // fixed!
     ASSERT_FALSE(valid.isValid(entry));
 }
 
+TEST(FixValidator, CanValidateFixation){
+    check_fixation(false);
+}
+
+TEST(FixValidator, CanValidateFixationPacked){
+    check_fixation(true);
+}
+
 TEST(BaseRegions, CanSet){
     BaseRegions region;
     std::ostringstream output;
@@ -615,3 +633,139 @@ TEST(BaseRegions, CanSubtractTriplets){
         }
     }
 }
+
+TEST(BaseRegions, CanInternChromosomes){
+    unsigned int first = chromosome_ids::id("intern_1");
+    unsigned int second = chromosome_ids::id("intern_2");
+    ASSERT_NE(first, second);
+    ASSERT_EQ(chromosome_ids::id("intern_1"), first);
+    ASSERT_EQ(chromosome_ids::name(first), "intern_1");
+    ASSERT_EQ(chromosome_ids::name(second), "intern_2");
+
+    // each chromosome is intersected separately
+    BaseRegions target, other;
+    target.add("intern_1", 0, 10);
+    target.add("intern_2", 0, 10);
+    other.add("intern_2", 5, 20);
+    target.intersect(other);
+    std::ostringstream output;
+    output << target;
+    ASSERT_STREQ(output.str().c_str(), "intern_1:\nintern_2:5,10,\n");
+}
+
+TEST(BaseRegions, CanDiscardBefore){
+    BaseRegions region;
+    unsigned long start;
+    ASSERT_FALSE(region.getStart("1", start));
+    region.add("1", 0, 10);
+    region.add("1", 20, 30);
+    region.add("1", 40, 50);
+    ASSERT_TRUE(region.getStart("1", start));
+    ASSERT_EQ(start, 0);
+
+    // intervals ending at the position are dropped, overlapping are kept
+    region.discardBefore("1", 25);
+    ASSERT_TRUE(region.getStart("1", start));
+    ASSERT_EQ(start, 20);
+    region.discardBefore("1", 30);
+    ASSERT_EQ(region.totalLength(), 10);
+    ASSERT_TRUE(region.inRegion("1", 45));
+    region.discardBefore("2", 100);  // no chromosome
+    region.discardBefore("1", 100);
+    ASSERT_FALSE(region.getStart("1", start));
+    ASSERT_EQ(region.totalLength(), 0);
+}
+
+TEST(BedValidator, SlidingCallableKeepsLaterIntervals){
+    std::ostringstream bed;
+    for(int i = 0; i < 100; ++i)
+        bed << "1\t" << i * 10 << '\t' << i * 10 + 5 << '\n';
+    std::istringstream infile(bed.str());
+    PositiveBedValidator validator(&infile);
+    BaseRegions region;
+    // overlapping windows see every interval they cover
+    for(unsigned long start = 0; start < 900; start += 25){
+        region.set("1", start, start + 50);
+        validator.updateCallable(region);
+        ASSERT_EQ(region.totalLength(), 25);
+    }
+}
+
+TEST(CallableIndex, MatchesValidatingEachWindow){
+    std::ostringstream include, exclude;
+    for(int i = 0; i < 200; ++i){
+        include << "1\t" << i * 10 << '\t' << i * 10 + 7 << '\n';
+        exclude << "1\t" << i * 15 + 3 << '\t' << i * 15 + 5 << '\n';
+    }
+    include << "2\t0\t50\n";
+    std::istringstream include_index(include.str()), exclude_index(exclude.str());
+    std::istringstream include_direct(include.str()), exclude_direct(exclude.str());
+    std::vector<std::unique_ptr<Validator>> index_validators, direct_validators;
+    index_validators.emplace_back(new PositiveBedValidator(&include_index));
+    index_validators.emplace_back(new NegativeBedValidator(&exclude_index));
+    direct_validators.emplace_back(new PositiveBedValidator(&include_direct));
+    direct_validators.emplace_back(new NegativeBedValidator(&exclude_direct));
+
+    CallableIndex index;
+    BaseRegions region;
+    // overlapping windows, skipping some, then a new chromosome
+    std::vector<std::pair<std::string, unsigned long>> windows;
+    for(unsigned long start = 0; start < 1500; start += 13)
+        if(start % 7 != 0)
+            windows.emplace_back("1", start);
+    windows.emplace_back("2", 10);
+    for(const auto &window : windows){
+        region.set(window.first, window.second, window.second + 40);
+        for(auto const &validator : direct_validators)
+            validator->updateCallable(region);
+        ASSERT_EQ(index.length(window.first, window.second,
+                    window.second + 40, index_validators),
+                region.totalLength()) << window.first << ':' << window.second;
+    }
+    ASSERT_EQ(index.length("1", 10, 10, index_validators), 0);
+    // the beds have moved past the start of chromosome 2
+    ASSERT_THROW(index.length("2", 0, 40, index_validators), std::logic_error);
+}
+
+TEST(MaskValidator, StacksBedFiles){
+    std::istringstream accessible(
+            "1\t0\t100\n"
+            "2\t0\t100\n");
+    std::istringstream segdup(
+            "1\t10\t20\n"
+            "2\t50\t60\n");
+    std::istringstream repeats(
+            "1\t15\t30\n");
+    std::vector<std::unique_ptr<Validator>> beds;
+    beds.emplace_back(new PositiveBedValidator(&accessible));
+    beds.emplace_back(new NegativeBedValidator(&segdup));
+    beds.emplace_back(new NegativeBedValidator(&repeats));
+    MaskValidator validator(std::move(beds));
+    VcfEntry entry("1", 0);
+
+    // in every include and no exclude
+    BaseRegions region;
+    region.set("1", 0, 50);
+    validator.updateCallable(region);
+    ASSERT_EQ(region.totalLength(), 30);
+    std::vector<unsigned long> positions{5, 10, 11, 20, 25, 30, 31, 100, 101};
+    std::vector<bool> valid{true, true, false, false, false, false, true, true, false};
+    for(size_t i = 0; i < positions.size(); ++i){
+        entry.position = positions[i];
+        ASSERT_EQ(validator.isValid(entry), valid[i]) << positions[i];
+    }
+
+    entry.chromosome = "2";
+    entry.position = 55;
+    ASSERT_FALSE(validator.isValid(entry));
+    entry.position = 61;
+    ASSERT_TRUE(validator.isValid(entry));
+    region.set("2", 40, 140);
+    validator.updateCallable(region);
+    ASSERT_EQ(region.totalLength(), 50);
+
+    // not in the include bed
+    entry.chromosome = "3";
+    entry.position = 5;
+    ASSERT_FALSE(validator.isValid(entry));
+}
@@ -45,3 +45,39 @@ TEST_F(VCF_Entry_Test, CanCountHaplotype){
     ASSERT_EQ(entry_5.count_haplotypes(std::vector<unsigned int> {0, 4}), 0);
     ASSERT_EQ(entry_5.count_haplotypes(std::vector<unsigned int> {}), 0);
 }
+
+TEST_F(VCF_Entry_Test, CanCountPackedHaplotype){
+    ASSERT_FALSE(entry_5.is_packed());
+    entry_5.pack_haplotypes();
+    ASSERT_TRUE(entry_5.is_packed());
+    ASSERT_THAT(entry_5.first_haplotype, ::testing::ElementsAre(0b01100));
+    ASSERT_THAT(entry_5.second_haplotype, ::testing::ElementsAre(0b00110));
+
+    std::vector<std::vector<unsigned int>> groups{
+        {0}, {0, 1}, {0, 2}, {0, 3, 4}, {1, 2, 3, 4}, {0, 4}, {}};
+    for(const auto &group : groups){
+        HaplotypeMask mask(group);
+        ASSERT_EQ(entry_5.any_haplotype(mask), entry_5.any_haplotype(group));
+        ASSERT_EQ(entry_5.count_haplotypes(mask), entry_5.count_haplotypes(group));
+    }
+}
+
+TEST(VCF_Entry, CanPackManyIndividuals){
+    VcfEntry entry("1", 150);
+    std::vector<unsigned int> all, odd;
+    for(unsigned int i = 0; i < 150; ++i){
+        entry.genotypes[i] = i % 4;
+        all.push_back(i);
+        if(i % 2)
+            odd.push_back(i);
+    }
+    entry.pack_haplotypes();
+    ASSERT_EQ(entry.first_haplotype.size(), 3);
+    ASSERT_EQ(entry.count_haplotypes(HaplotypeMask(all)),
+            entry.count_haplotypes(all));
+    ASSERT_EQ(entry.count_haplotypes(HaplotypeMask(odd)),
+            entry.count_haplotypes(odd));
+    ASSERT_EQ(entry.count_haplotypes(HaplotypeMask({149})), 1);
+    ASSERT_FALSE(entry.any_haplotype(HaplotypeMask({0, 64, 128})));
+    ASSERT_TRUE(entry.any_haplotype(HaplotypeMask({0, 64, 129})));
+}
@@ -121,6 +121,80 @@ TEST_F(VCF_File_F, CanParseLine){
             entry));
 }
 
+TEST_F(VCF_File_F, CanParseLineWithLength){
+    VcfEntry entry = vcf.initialize_entry();
+    // lines from a memory map are followed by the next line
+    std::string lines(
+            "2\t8\t.\tC\tG\t.\tPASS\t.\tGT\t1|0\t1|0\t0|1\t0|1\t0|0\t1|1\n"
+            "10\t9\t.\tA\tT\t.\tPASS\t.\tGT\t1|1\t1|1\t1|1\t1|1\t1|1\t1|1\n");
+    size_t length = lines.find('\n');
+    ASSERT_TRUE(vcf.parse_line(lines.data(), length, entry));
+    ASSERT_STREQ(entry.chromosome.c_str(), "2");
+    ASSERT_EQ(entry.position, 8);
+    ASSERT_THAT(entry.genotypes, ::testing::ElementsAre(1, 2, 3));
+
+    ASSERT_TRUE(vcf.parse_line(lines.data() + length + 1,
+                lines.size() - length - 2, entry));
+    ASSERT_STREQ(entry.chromosome.c_str(), "10");
+    ASSERT_EQ(entry.position, 9);
+    ASSERT_THAT(entry.genotypes, ::testing::ElementsAre(3, 3, 3));
+
+    // genotypes are not read past the end of the line
+    ASSERT_TRUE(vcf.parse_line(lines.data(), length - 1, entry));
+    ASSERT_THAT(entry.genotypes, ::testing::ElementsAre(1, 2, 1));
+}
+
+TEST_F(VCF_File_F, CanParseLineSkippingColumns){
+    VcfEntry entry = vcf.initialize_entry();
+    // unselected fields of other widths, and columns after the last
+    // selected individual are not read
+    ASSERT_TRUE(vcf.parse_line(
+            "1\t7\t.\tA\tT\t.\tPASS\t.\tGT:DP\t0|0:12\t1|1:3\t.\t0|1:4"
+            "\t1|1:150\t1|0\tnot\ta\tgenotype",
+            entry));
+    ASSERT_THAT(entry.genotypes, ::testing::ElementsAre(3, 2, 1));
+
+    // short fields are not skipped as one 3 character field
+    ASSERT_TRUE(vcf.parse_line(
+            "1\t8\t.\tA\tT\t.\tPASS\t.\tGT\t0\t1|0\t1\t1|1\t0|0\t0|1",
+            entry));
+    ASSERT_THAT(entry.genotypes, ::testing::ElementsAre(1, 3, 2));
+
+    // missing individuals are not updated
+    ASSERT_TRUE(vcf.parse_line(
+            "1\t9\t.\tA\tT\t.\tPASS\t.\tGT\t0|0\t0|0\t0|0",
+            entry));
+    ASSERT_THAT(entry.genotypes, ::testing::ElementsAre(0, 3, 2));
+}
+
+TEST(VCF_File, ParseLineSameForSimdLevels){
+    std::string header = "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+    std::string line = "1\t7\t.\tA\tT\t.\tPASS\t.\tGT";
+    std::vector<uint8_t> expected;
+    for(int i = 0; i < 40; ++i){
+        header += "\tmsp_" + std::to_string(i);
+        line += i == 25 ? "\t1/1" : i % 3 == 0 ? "\t.|1" : i % 2 ? "\t1|0" : "\t1|1";
+        expected.push_back(i == 25 ? 3 : i % 3 == 0 ? 0 : i % 2 ? 1 : 3);
+    }
+
+    for(auto level : {SimdLevel::scalar, SimdLevel::sse4, SimdLevel::avx2}){
+        if(level > detect_simd_level())
+            continue;
+        VcfFile vcf;
+        vcf.set_simd_level(level);
+        vcf.set_track_unphased(true);
+        vcf.initialize_individuals(header, {});
+        VcfEntry entry = vcf.initialize_entry();
+        testing::internal::CaptureStderr();
+        ASSERT_TRUE(vcf.parse_line(line.c_str(), entry));
+        ASSERT_EQ(entry.genotypes, expected);
+        ASSERT_THAT(entry.unphased_individuals,
+                ::testing::ElementsAre((uint64_t)1 << 25));
+        ASSERT_STREQ(testing::internal::GetCapturedStderr().c_str(),
+                "WARNING: Detected unphased haplotype at chrom 1 and pos 7!\n");
+    }
+}
+
 TEST_F(VCF_File_F, ParseLineUnphasedMakesWarning){
     VcfEntry entry = vcf.initialize_entry();
     // warn for unphased haplotypes
@@ -148,3 +222,22 @@ TEST_F(VCF_File_F, ParseLineUnphasedMakesWarning){
     output = testing::internal::GetCapturedStderr();
     ASSERT_STREQ(output.c_str(), "");
 }
+
+TEST_F(VCF_File_F, ParseLineWarnsOnceWhenShared){
+    std::atomic<bool> warned{false};
+    VcfFile other = vcf;
+    vcf.share_unphased_warning(warned);
+    other.share_unphased_warning(warned);
+    VcfEntry entry = vcf.initialize_entry();
+
+    testing::internal::CaptureStderr();
+    ASSERT_TRUE(vcf.parse_line(
+            "3\t10\t.\tC\tG\t.\tPASS\t.\tGT\t0|0\t1/0\t0|0\t0|0\t0|0\t0|0",
+            entry));
+    ASSERT_TRUE(other.parse_line(
+            "4\t12\t.\tC\tG\t.\tPASS\t.\tGT\t0|0\t1/0\t0|0\t0|0\t0|0\t0|0",
+            entry));
+    ASSERT_STREQ(testing::internal::GetCapturedStderr().c_str(),
+            "WARNING: Detected unphased haplotype at chrom 3 and pos 10!\n");
+    ASSERT_EQ(other.unphased_genotypes(), 1);
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+
+#include "sstar2/vcf_index.h"
+
+using testing::ElementsAre;
+
+// writes little endian index fields
+class IndexWriter{
+    public:
+        std::string data;
+        template <typename T>
+        IndexWriter& add(T value){
+            for(size_t i = 0; i < sizeof(T); ++i)
+                data += (char)((uint64_t)value >> (8 * i) & 0xff);
+            return *this;
+        }
+        IndexWriter& add_names(){
+            std::string names("1\0X\0", 4);
+            for(int32_t value : {2, 1, 2, 0, (int)'#', 0})
+                add(value);
+            add((int32_t)names.size());
+            data += names;
+            return *this;
+        }
+};
+
+// chromosome 1 has records in leaf bins of the first and third 16kb
+// window and a record spanning both in a level 4 bin
+// chromosome X has a single record
+void add_bins(IndexWriter &index, bool csi){
+    index.add((int32_t)3);
+    index.add((uint32_t)4681);
+    if(csi)
+        index.add((uint64_t)0x10000);
+    index.add((int32_t)1).add((uint64_t)0x10000).add((uint64_t)0x20000);
+    index.add((uint32_t)4683);
+    if(csi)
+        index.add((uint64_t)0x50000);
+    index.add((int32_t)2)
+        .add((uint64_t)0x50000).add((uint64_t)0x60000)
+        .add((uint64_t)0x70000).add((uint64_t)0x80000);
+    index.add((uint32_t)585);
+    if(csi)
+        index.add((uint64_t)0x20000);
+    index.add((int32_t)1).add((uint64_t)0x20000).add((uint64_t)0x50000);
+    if(!csi)
+        index.add((int32_t)3).add((uint64_t)0x10000)
+            .add((uint64_t)0x20000).add((uint64_t)0x50000);
+
+    index.add((int32_t)1);
+    index.add((uint32_t)4681);
+    if(csi)
+        index.add((uint64_t)0x90000);
+    index.add((int32_t)1).add((uint64_t)0x90000).add((uint64_t)0xa0000);
+    if(!csi)
+        index.add((int32_t)1).add((uint64_t)0x90000);
+}
+
+std::string make_tabix(){
+    IndexWriter index;
+    index.data = "TBI\1";
+    index.add((int32_t)2).add_names();
+    add_bins(index, false);
+    return index.data;
+}
+
+std::string make_csi(){
+    IndexWriter names;
+    names.add_names();
+    IndexWriter index;
+    index.data = "CSI\1";
+    index.add((int32_t)14).add((int32_t)5).add((int32_t)names.data.size());
+    index.data += names.data;
+    index.add((int32_t)2);
+    add_bins(index, true);
+    return index.data;
+}
+
+void check_queries(const VcfIndex &index){
+    ASSERT_THAT(index.chromosomes(), ElementsAre("1", "X"));
+
+    // adjacent and overlapping chunks are merged
+    ASSERT_THAT(index.query("1", 0, 100), ElementsAre(
+                IndexChunk{0x10000, 0x50000}));
+    ASSERT_THAT(index.query("1", 0, 40000), ElementsAre(
+                IndexChunk{0x10000, 0x60000},
+                IndexChunk{0x70000, 0x80000}));
+    // chunks ending before the first record of the window are skipped
+    ASSERT_THAT(index.query("1", 33000, 40000), ElementsAre(
+                IndexChunk{0x50000, 0x60000},
+                IndexChunk{0x70000, 0x80000}));
+    ASSERT_THAT(index.query("X", 0, 1000), ElementsAre(
+                IndexChunk{0x90000, 0xa0000}));
+    ASSERT_THAT(index.query("X", 20000, 1000000), ElementsAre());
+    ASSERT_THAT(index.query("2", 0, 1000), ElementsAre());
+    ASSERT_THAT(index.query("1", 100, 100), ElementsAre());
+}
+
+TEST(VcfIndex, CanReadTabix){
+    std::istringstream input(make_tabix());
+    VcfIndex index(input);
+    check_queries(index);
+}
+
+TEST(VcfIndex, CanReadCsi){
+    std::istringstream input(make_csi());
+    VcfIndex index(input);
+    check_queries(index);
+}
+
+TEST(VcfIndex, ThrowsOnInvalidIndex){
+    std::istringstream bad_magic("BAM\1");
+    ASSERT_THROW(VcfIndex index(bad_magic), std::invalid_argument);
+    std::istringstream truncated(make_tabix().substr(0, 60));
+    ASSERT_THROW(VcfIndex index(truncated), std::invalid_argument);
+
+    // csi without names in the auxiliary data
+    IndexWriter csi;
+    csi.data = "CSI\1";
+    csi.add((int32_t)14).add((int32_t)5).add((int32_t)0).add((int32_t)0);
+    std::istringstream no_names(csi.data);
+    ASSERT_THROW(VcfIndex index(no_names), std::invalid_argument);
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <limits>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
@@ -14,7 +15,7 @@ TEST(WindowBucket, CanResetBucket){
     ASSERT_EQ(bucket.end, 0);
     ASSERT_EQ(bucket.site_count, 0);
     ASSERT_EQ(bucket.reference_count, 0);
-    ASSERT_EQ(bucket.genotypes.size(), 0);
+    ASSERT_EQ(bucket.counts.size(), 0);
 
     // empty bucket
     bucket.reset_bucket(0, 10);
@@ -22,24 +23,36 @@ TEST(WindowBucket, CanResetBucket){
     ASSERT_EQ(bucket.end, 10);
     ASSERT_EQ(bucket.site_count, 0);
     ASSERT_EQ(bucket.reference_count, 0);
-    ASSERT_EQ(bucket.genotypes.size(), 0);
+    ASSERT_EQ(bucket.counts.size(), 0);
 
     // modify some values
+    bucket.initialize(2);
     bucket.site_count += 5;
     bucket.reference_count += 3;
-    bucket.genotypes.resize(2);
-    bucket.genotypes[0].push_back({1, 1});
-    bucket.genotypes[0].push_back({2, 2});
-    bucket.genotypes[1].push_back({2, 3});
+    bucket.add(0, 1, 1);
+    bucket.add(1, 2, 3);
+    bucket.add(0, 2, 2);
     ASSERT_EQ(bucket.start, 0);
     ASSERT_EQ(bucket.end, 10);
     ASSERT_EQ(bucket.site_count, 5);
     ASSERT_EQ(bucket.reference_count, 3);
-    ASSERT_EQ(bucket.genotypes.size(), 2);
-    ASSERT_THAT(bucket.genotypes[0],
-            ElementsAre(WindowGT{1, 1}, WindowGT{2, 2}));
-    ASSERT_THAT(bucket.genotypes[1],
-            ElementsAre(WindowGT{2, 3}));
+    ASSERT_THAT(bucket.counts, ElementsAre(2, 1));
+    ASSERT_FALSE(bucket.sealed);
+
+    // grouped by target, in record order
+    bucket.seal();
+    ASSERT_TRUE(bucket.sealed);
+    ASSERT_THAT(bucket.offsets, ElementsAre(0, 2, 3));
+    ASSERT_THAT(bucket.positions, ElementsAre(1, 2, 2));
+    ASSERT_THAT(bucket.genotypes, ElementsAre(1, 2, 3));
+
+    // adding after sealing keeps the grouping
+    bucket.add(1, 5, 1);
+    ASSERT_FALSE(bucket.sealed);
+    bucket.seal();
+    ASSERT_THAT(bucket.offsets, ElementsAre(0, 2, 4));
+    ASSERT_THAT(bucket.positions, ElementsAre(1, 2, 2, 5));
+    ASSERT_THAT(bucket.genotypes, ElementsAre(1, 2, 3, 1));
 
     // empty bucket
     bucket.reset_bucket(5, 15);
@@ -47,9 +60,10 @@ TEST(WindowBucket, CanResetBucket){
     ASSERT_EQ(bucket.end, 15);
     ASSERT_EQ(bucket.site_count, 0);
     ASSERT_EQ(bucket.reference_count, 0);
-    ASSERT_EQ(bucket.genotypes.size(), 2);
-    ASSERT_EQ(bucket.genotypes[0].size(), 0);
-    ASSERT_EQ(bucket.genotypes[1].size(), 0);
+    ASSERT_THAT(bucket.counts, ElementsAre(0, 0));
+    ASSERT_THAT(bucket.offsets, ElementsAre(0, 0, 0));
+    ASSERT_EQ(bucket.positions.size(), 0);
+    ASSERT_EQ(bucket.genotypes.size(), 0);
 }
 
 TEST(StepWindow, CanInitializeValidate){
@@ -276,6 +290,7 @@ TEST(StepWindow, CanRecordValues){
     ASSERT_EQ(window.individual_snps(0), 3);
     ASSERT_EQ(window.individual_snps(1), 4);
     ASSERT_EQ(window.individual_snps(2), 3);
+    ASSERT_THAT(window.individual_counts(), ElementsAre(3, 4, 3));
 }
 
 TEST(RangedWindow, CanInitializeValidateString){
@@ -390,3 +405,85 @@ TEST(RangedWindow, CanStartWindow){
     ASSERT_EQ(window2.individual_snps(0), 0);
 }
 
+
+TEST(RangedWindow, CanStepThroughRegion){
+    RangedWindow window(5, 10, "chrom:3-15");
+    window.initialize(1);
+    std::vector<unsigned int> targets{0};
+    VcfEntry line{"chrom", 1};
+    line.genotypes[0] = 1;
+
+    line.position = 2;
+    window.start_window(line);
+    ASSERT_FALSE(window.should_break(line));
+    ASSERT_FALSE(window.should_record(line));  // before region
+
+    line.position = 14;
+    ASSERT_TRUE(window.should_break(line));
+    window.start_window(line);
+    ASSERT_EQ(window.start, 8);
+    ASSERT_EQ(window.end, 18);
+    ASSERT_EQ(window.callable_bases.totalLength(), 7);  // clipped to region
+    ASSERT_FALSE(window.should_break(line));
+    ASSERT_TRUE(window.should_record(line));
+    window.record(line, targets, 0);
+    ASSERT_EQ(window.total_snps(), 1);
+
+    // past the region end, break until windows start after the region
+    line.position = 17;
+    ASSERT_TRUE(window.should_break(line));
+    window.start_window(line);
+    ASSERT_STREQ(window.chromosome.c_str(), "chrom");
+    ASSERT_EQ(window.start, 13);
+    ASSERT_EQ(window.total_snps(), 1);  // carried over bucket
+    ASSERT_TRUE(window.should_break(line));
+    window.start_window(line);
+    ASSERT_STREQ(window.chromosome.c_str(), "");
+    ASSERT_EQ(window.total_snps(), 0);
+
+    // rest of chromosome is read without recording
+    line.position = 100;
+    ASSERT_FALSE(window.should_break(line));
+    ASSERT_FALSE(window.should_record(line));
+    line.chromosome = "other";
+    ASSERT_TRUE(window.should_break(line));
+}
+
+TEST(RangedWindow, CanSkipChromosome){
+    std::istringstream input("chrom1\t10\t100\nchrom3\t0\t50\n");
+    RangedWindow window(5, 10, input);
+    window.initialize(1);
+    VcfEntry line{"chrom2", 1};
+    line.position = 20;
+
+    window.start_window(line);
+    ASSERT_STREQ(window.chromosome.c_str(), "");
+    ASSERT_FALSE(window.should_break(line));
+    ASSERT_FALSE(window.should_record(line));
+    line.chromosome = "chrom3";
+    ASSERT_TRUE(window.should_break(line));
+    window.start_window(line);
+    ASSERT_STREQ(window.chromosome.c_str(), "chrom3");
+    ASSERT_EQ(window.start, 0);
+    ASSERT_EQ(window.end, 10);
+    ASSERT_TRUE(window.should_break(line));
+}
+
+TEST(RangedWindow, CanGetRegion){
+    unsigned long start, end;
+    StepWindow step(5, 10);
+    ASSERT_TRUE(step.region("chrom", start, end));
+    ASSERT_EQ(start, 0);
+    ASSERT_EQ(end, std::numeric_limits<unsigned long>::max());
+
+    RangedWindow window(5, 10, "chrom:3-15");
+    ASSERT_TRUE(window.region("chrom", start, end));
+    ASSERT_EQ(start, 3);
+    ASSERT_EQ(end, 15);
+    ASSERT_FALSE(window.region("other", start, end));
+
+    RangedWindow all(5, 10, "3-15");
+    ASSERT_TRUE(all.region("other", start, end));
+    ASSERT_EQ(start, 3);
+    ASSERT_EQ(end, 15);
+}
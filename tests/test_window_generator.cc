@@ -1,6 +1,7 @@
 #include <iostream>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <zlib.h>
 
 #include "sstar2/window_generator.h"
 
@@ -130,6 +131,38 @@ TEST_F(Generator_Input, StepCanYieldWindow){
     ASSERT_FALSE(gen.next_window());
 }
 
+TEST_F(Generator_Input, StepCanYieldWindowWithMask){
+    // records are checked for fixation and against the bed mask
+    WindowGenerator gen(std::unique_ptr<Window>(new StepWindow(5, 10)));
+    std::set<std::string> target, reference, exclude;
+    target.insert("EUR");
+    reference.insert("AFR");
+    exclude.insert("ASN");
+    std::istringstream vcf(vcf_str);
+    std::istringstream pop(pop_str);
+    gen.initialize(vcf, pop, target, reference, exclude);
+    std::istringstream bed("1\t5\t6\n");
+    std::vector<std::unique_ptr<Validator>> beds;
+    beds.emplace_back(new NegativeBedValidator(&bed));
+    gen.add_validator(std::unique_ptr<Validator>(new MaskValidator(std::move(beds))));
+
+    ASSERT_TRUE(gen.next_window());
+    ASSERT_EQ(gen.window->start, 0);
+    ASSERT_EQ(gen.window->total_snps(), 1);
+    ASSERT_EQ(gen.window->reference_snps(), 0);
+    ASSERT_EQ(gen.window->individual_snps(0), 1);
+    ASSERT_EQ(gen.callable_length(), 9);
+
+    ASSERT_TRUE(gen.next_window());
+    ASSERT_EQ(gen.window->start, 5);
+    ASSERT_EQ(gen.window->total_snps(), 1);
+    ASSERT_EQ(gen.window->reference_snps(), 0);
+    ASSERT_EQ(gen.window->individual_snps(0), 1);
+    ASSERT_EQ(gen.callable_length(), 9);
+
+    ASSERT_FALSE(gen.next_window());
+}
+
 TEST_F(Generator_Input, StepCanYieldWindow2){
     // repeated calls to yield window update chrom, start and end
     WindowGenerator gen(std::unique_ptr<Window>(new StepWindow(2, 5)));
@@ -201,3 +234,220 @@ TEST_F(Generator_Input, StepCanYieldOddWindow){
 
     ASSERT_FALSE(gen.next_window());
 }
+
+TEST_F(Generator_Input, RangedCanYieldWindow){
+    // only windows in the region are recorded
+    WindowGenerator gen(std::unique_ptr<Window>(new RangedWindow(5, 10, "1:3-12")));
+    std::set<std::string> target, reference, exclude;
+    target.insert("EUR");
+    reference.insert("AFR");
+    exclude.insert("ASN");
+    std::istringstream vcf(vcf_str);
+    std::istringstream pop(pop_str);
+    gen.initialize(vcf, pop, target, reference, exclude);
+
+    ASSERT_TRUE(gen.next_window());
+    ASSERT_STREQ(gen.window->chromosome.c_str(), "1");
+    ASSERT_EQ(gen.window->start, 3);
+    ASSERT_EQ(gen.window->end, 13);
+    ASSERT_EQ(gen.window->total_snps(), 2);
+    ASSERT_EQ(gen.window->reference_snps(), 1);
+    ASSERT_EQ(gen.window->individual_snps(0), 1);
+
+    // record at 15 is past the region
+    ASSERT_TRUE(gen.next_window());
+    ASSERT_STREQ(gen.window->chromosome.c_str(), "1");
+    ASSERT_EQ(gen.window->start, 8);
+    ASSERT_EQ(gen.window->end, 18);
+    ASSERT_EQ(gen.window->total_snps(), 0);
+    ASSERT_EQ(gen.window->callable_bases.totalLength(), 4);
+
+    ASSERT_TRUE(gen.next_window());
+    ASSERT_STREQ(gen.window->chromosome.c_str(), "");
+    ASSERT_EQ(gen.window->total_snps(), 0);
+
+    ASSERT_FALSE(gen.next_window());
+}
+
+// a single bgzf block
+std::string bgzf_block(const std::string &data){
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    deflateInit2(&stream, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    std::string deflated(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef*)&deflated[0];
+    stream.avail_out = deflated.size();
+    deflate(&stream, Z_FINISH);
+    deflated.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    auto le = [](uint64_t value, int length){
+        std::string result;
+        for(int i = 0; i < length; ++i)
+            result += (char)((value >> (8 * i)) & 0xff);
+        return result;
+    };
+    return std::string("\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0", 16) +
+        le(deflated.size() + 25, 2) + deflated +
+        le(crc32(0L, (const Bytef*)data.data(), data.size()), 4) +
+        le(data.size(), 4);
+}
+
+// tabix index of chromosomes 1 and 2 with one bin per chromosome,
+// chromosome i spanning offsets[i] to offsets[i + 1]
+std::string tabix_index(const std::vector<uint64_t> &offsets){
+    std::string tabix("TBI\1", 4);
+    auto add = [&](uint64_t value, int length){
+        for(int i = 0; i < length; ++i)
+            tabix += (char)((value >> (8 * i)) & 0xff);
+    };
+    add(2, 4);
+    for(int value : {2, 1, 2, 0, (int)'#', 0, 4})
+        add(value, 4);
+    tabix += std::string("1\0" "2\0", 4);
+    for(int chrom = 1; chrom <= 2; ++chrom){
+        add(1, 4);
+        add(4681, 4);
+        add(1, 4);
+        add(offsets[chrom], 8);
+        add(offsets[chrom + 1], 8);
+        add(1, 4);
+        add(offsets[chrom], 8);
+    }
+    return tabix;
+}
+
+TEST_F(Generator_Input, RangedCanSeekWithIndex){
+    // chromosome 1 is invalid, so would throw if read
+    std::string header = vcf_str.substr(0, vcf_str.find("\n1\t") + 1);
+    std::string chrom1 = "1\t1\t.\tA\tT\t.\tPASS\t.\tXX\t0|0\t0|0\t0|0\t0|0\t0|0\t0|0\n";
+    std::string chrom2 = vcf_str.substr(header.size());
+    for(size_t i = 0; i != std::string::npos; i = chrom2.find("\n1\t", i))
+        chrom2[i == 0 ? 0 : i + 1] = '2';
+
+    std::vector<uint64_t> offsets;
+    std::string bgzf;
+    for(const auto &block : {header, chrom1, chrom2, std::string()}){
+        offsets.push_back(bgzf.size() << 16);
+        bgzf += bgzf_block(block);
+    }
+
+    std::istringstream index_input(tabix_index(offsets));
+    VcfIndex index(index_input);
+    std::istringstream compressed(bgzf);
+    GzipStreamBuf buffer(compressed);
+    std::istream vcf(&buffer);
+
+    WindowGenerator gen(std::unique_ptr<Window>(new RangedWindow(5, 10, "2:0-20")));
+    gen.set_index(index);
+    std::set<std::string> target, reference, exclude;
+    target.insert("EUR");
+    reference.insert("AFR");
+    exclude.insert("ASN");
+    std::istringstream pop(pop_str);
+    gen.initialize(vcf, pop, target, reference, exclude);
+
+    ASSERT_TRUE(gen.next_window());
+    ASSERT_STREQ(gen.window->chromosome.c_str(), "2");
+    ASSERT_EQ(gen.window->start, 0);
+    ASSERT_EQ(gen.window->end, 10);
+    ASSERT_EQ(gen.window->total_snps(), 2);
+    ASSERT_EQ(gen.window->reference_snps(), 1);
+    ASSERT_EQ(gen.window->individual_snps(0), 1);
+
+    ASSERT_TRUE(gen.next_window());
+    ASSERT_STREQ(gen.window->chromosome.c_str(), "2");
+    ASSERT_EQ(gen.window->start, 5);
+    ASSERT_EQ(gen.window->end, 15);
+    ASSERT_EQ(gen.window->total_snps(), 2);
+    ASSERT_EQ(gen.window->reference_snps(), 1);
+    ASSERT_EQ(gen.window->individual_snps(0), 1);
+
+    ASSERT_FALSE(gen.next_window());
+}
+
+TEST_F(Generator_Input, RangedCanSeekEachChromosome){
+    // records of chromosome 2 follow the region on chromosome 1 and are
+    // read before seeking, but only recorded once
+    std::string header = vcf_str.substr(0, vcf_str.find("\n1\t") + 1);
+    std::string chrom1 = vcf_str.substr(header.size());
+    // starting with a recorded snp
+    std::string chrom2 = chrom1.substr(chrom1.find("\n1\t5\t") + 1);
+    for(size_t i = 0; i != std::string::npos; i = chrom2.find("\n1\t", i))
+        chrom2[i == 0 ? 0 : i + 1] = '2';
+
+    std::vector<uint64_t> offsets;
+    std::string bgzf;
+    for(const auto &block : {header, chrom1, chrom2, std::string()}){
+        offsets.push_back(bgzf.size() << 16);
+        bgzf += bgzf_block(block);
+    }
+
+    std::istringstream index_input(tabix_index(offsets));
+    VcfIndex index(index_input);
+    std::istringstream compressed(bgzf);
+    GzipStreamBuf buffer(compressed);
+    std::istream vcf(&buffer);
+
+    std::istringstream regions("1\t0\t20\n2\t0\t20\n");
+    WindowGenerator gen(std::unique_ptr<Window>(new RangedWindow(5, 10, regions)));
+    gen.set_index(index);
+    std::set<std::string> target, reference, exclude;
+    target.insert("EUR");
+    reference.insert("AFR");
+    exclude.insert("ASN");
+    std::istringstream pop(pop_str);
+    gen.initialize(vcf, pop, target, reference, exclude);
+
+    for(std::string chrom : {"1", "2"}){
+        ASSERT_TRUE(gen.next_window());
+        ASSERT_EQ(gen.window->chromosome, chrom);
+        ASSERT_EQ(gen.window->start, 0);
+        ASSERT_EQ(gen.window->end, 10);
+        ASSERT_EQ(gen.window->total_snps(), 2);
+
+        ASSERT_TRUE(gen.next_window());
+        ASSERT_EQ(gen.window->chromosome, chrom);
+        ASSERT_EQ(gen.window->start, 5);
+        ASSERT_EQ(gen.window->end, 15);
+        ASSERT_EQ(gen.window->total_snps(), 2);
+    }
+
+    ASSERT_FALSE(gen.next_window());
+}
+
+TEST_F(Generator_Input, StepCanReadChromosome){
+    // only the second chromosome is read, starting from its offset
+    std::string chrom2 = vcf_str.substr(vcf_str.find("\n1\t") + 1);
+    for(size_t i = 0; i != std::string::npos; i = chrom2.find("\n1\t", i))
+        chrom2[i == 0 ? 0 : i + 1] = '2';
+    std::string input = vcf_str + chrom2 + vcf_str.substr(vcf_str.find("\n1\t") + 1);
+    std::istringstream vcf(input);
+
+    WindowGenerator gen(std::unique_ptr<Window>(new StepWindow(5, 10)));
+    gen.set_chromosome("2", vcf_str.size());
+    std::set<std::string> target, reference, exclude;
+    target.insert("EUR");
+    reference.insert("AFR");
+    exclude.insert("ASN");
+    std::istringstream pop(pop_str);
+    gen.initialize(vcf, pop, target, reference, exclude);
+
+    ASSERT_TRUE(gen.next_window());
+    ASSERT_STREQ(gen.window->chromosome.c_str(), "2");
+    ASSERT_EQ(gen.window->start, 0);
+    ASSERT_EQ(gen.window->end, 10);
+    ASSERT_EQ(gen.window->total_snps(), 2);
+
+    ASSERT_TRUE(gen.next_window());
+    ASSERT_STREQ(gen.window->chromosome.c_str(), "2");
+    ASSERT_EQ(gen.window->start, 5);
+    ASSERT_EQ(gen.window->end, 15);
+    ASSERT_EQ(gen.window->total_snps(), 2);
+
+    ASSERT_FALSE(gen.next_window());
+}
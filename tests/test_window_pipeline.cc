@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sstream>
+#include <set>
+
+#include "sstar2/window_pipeline.h"
+
+class PipelineFixture : public ::testing::Test{
+    protected:
+        void SetUp(){
+            std::ostringstream vcf_builder;
+            vcf_builder << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\t"
+                "FORMAT\tmsp_0\tmsp_1\tmsp_2\tmsp_3\tref\n";
+            // deterministic pattern over two chromosomes
+            for(int chrom = 1; chrom <= 2; ++chrom){
+                for(int pos = 7; pos < 400; pos += 3){
+                    vcf_builder << chrom << '\t' << pos << "\t.\tA\tT\t.\tPASS\t.\tGT";
+                    for(int indiv = 0; indiv < 5; ++indiv){
+                        int value = (pos * (indiv + 3) + chrom) % 7;
+                        vcf_builder << '\t' << (value == 1 || value == 3) << '|'
+                            << (value == 2 || value == 3);
+                    }
+                    vcf_builder << '\n';
+                }
+            }
+            vcf_str = vcf_builder.str();
+        }
+
+        std::string run(unsigned int workers, unsigned int in_flight){
+            std::set<std::string> target, reference, exclude;
+            target.insert("targ");
+            reference.insert("ref");
+            std::istringstream vcf(vcf_str);
+            std::istringstream pop(pop_str);
+            WindowGenerator generator{std::unique_ptr<Window>(new StepWindow(20, 50))};
+            generator.initialize(vcf, pop, target, reference, exclude);
+            SStarCaller sstar(50, -100);
+            std::ostringstream output;
+            if(workers == 0){
+                while(generator.next_window())
+                    sstar.write_window(output, generator);
+            }
+            else{
+                WindowPipeline pipeline(sstar, workers, in_flight);
+                pipeline.run(generator, output);
+            }
+            return output.str();
+        }
+
+        std::string vcf_str;
+        std::string pop_str{
+            "samp\tpop\tsuper_pop\n"
+            "msp_0\tpop0\ttarg\n"
+            "msp_1\tpop1\ttarg\n"
+            "msp_2\tpop2\ttarg\n"
+            "msp_3\tpop3\ttarg\n"
+            "ref\t.\tref\n"
+        };
+};
+
+TEST_F(PipelineFixture, MatchesSerialOutput){
+    std::string expected = run(0, 0);
+    ASSERT_GT(expected.size(), 0);
+    ASSERT_EQ(run(1, 1), expected);
+    ASSERT_EQ(run(4, 2), expected);
+    ASSERT_EQ(run(3, 16), expected);
+}
+
+TEST_F(PipelineFixture, RethrowsReadErrors){
+    vcf_str += "3\t10\t.\tA\tT\t.\tPASS\t.\tXX\t0|0\t0|0\t0|0\t0|0\t0|0\n";
+    ASSERT_THROW(run(2, 2), std::invalid_argument);
+}
+
+// windows where no snps of a target are 10 bp apart have no sstar snps
+TEST(PipelineDenseSnps, EmptySStarMatchesSerialOutput){
+    std::string vcf_str =
+        "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\t"
+        "FORMAT\tmsp_0\tmsp_1\tref\n"
+        "1\t10\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\t1|1\t0|0\n"
+        "1\t30\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\t1|1\t0|0\n"
+        "1\t45\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\t1|1\t0|0\n"
+        "1\t110\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\t1|1\t0|0\n"
+        "1\t112\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\t1|0\t0|0\n"
+        "1\t114\t.\tA\tT\t.\tPASS\t.\tGT\t0|1\t1|1\t0|0\n"
+        "1\t116\t.\tA\tT\t.\tPASS\t.\tGT\t1|0\t0|1\t1|0\n";
+    std::string pop_str =
+        "samp\tpop\tsuper_pop\n"
+        "msp_0\tpop0\ttarg\n"
+        "msp_1\tpop1\ttarg\n"
+        "ref\t.\tref\n";
+    auto run = [&](unsigned int threads, unsigned int in_flight){
+        std::set<std::string> target{"targ"}, reference{"ref"}, exclude;
+        std::istringstream vcf(vcf_str), pop(pop_str);
+        WindowGenerator generator{std::unique_ptr<Window>(new StepWindow(100, 100))};
+        generator.initialize(vcf, pop, target, reference, exclude);
+        SStarCaller sstar;
+        std::ostringstream output;
+        if(in_flight == 0){
+            sstar.set_threads(threads);
+            while(generator.next_window())
+                sstar.write_window(output, generator);
+        }
+        else{
+            WindowPipeline pipeline(sstar, threads, in_flight);
+            pipeline.run(generator, output);
+        }
+        return output.str();
+    };
+
+    std::string expected = run(1, 0);
+    ASSERT_THAT(expected, testing::EndsWith(
+                "1\t100\t200\t4\t3\t4\tmsp_0\tpop0\t"
+                "-100000\t0\t\t0\t0\t0\t0\t0\t0\t0\t0\t\t100\n"
+                "1\t100\t200\t4\t3\t4\tmsp_1\tpop1\t"
+                "-100000\t0\t\t0\t0\t0\t0\t0\t0\t0\t0\t\t100\n"));
+    ASSERT_EQ(run(2, 0), expected);
+    ASSERT_EQ(run(4, 4), expected);
+}